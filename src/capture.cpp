@@ -0,0 +1,470 @@
+#include "capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static inline constexpr auto MaxRowBytes = 256 / 4;
+
+static void pack_bits(const uint8_t* data, int size, std::vector<uint8_t>& output)
+{
+    int index = 0;
+    while (index < size)
+    {
+        int run = 1;
+        while (index + run < size && run < 128 && data[index + run] == data[index])
+            run++;
+
+        if (run >= 2)
+        {
+            output.push_back((uint8_t)(1 - run));
+            output.push_back(data[index]);
+            index += run;
+            continue;
+        }
+
+        // Literals stop where a run of two starts
+        const int start = index;
+        while (index < size && (index - start) < 128 && !(index + 1 < size && data[index] == data[index + 1]))
+            index++;
+
+        output.push_back((uint8_t)(index - start - 1));
+        output.insert(output.end(), data + start, data + index);
+    }
+}
+
+static bool unpack_bits(const uint8_t*& input, const uint8_t* end, uint8_t* data, int size)
+{
+    int index = 0;
+    while (index < size)
+    {
+        if (input >= end)
+            return false;
+
+        const int control = (int8_t)*input++;
+        if (control >= 0)
+        {
+            const int count = control + 1;
+            if (index + count > size || end - input < count)
+                return false;
+
+            std::memcpy(data + index, input, count);
+            input += count;
+            index += count;
+        }
+        else if (control != -128)
+        {
+            const int count = 1 - control;
+            if (index + count > size || input >= end)
+                return false;
+
+            std::memset(data + index, *input++, count);
+            index += count;
+        }
+    }
+
+    return true;
+}
+
+bool encode_display_delta(const uint8_t* display, const uint8_t* previous, int width, int height, std::vector<uint8_t>& output)
+{
+    const size_t bitmap_offset = output.size();
+    const int row_bytes = width / 4;
+    bool changed = false;
+    uint8_t row[MaxRowBytes];
+
+    output.resize(bitmap_offset + (height + 7) / 8, 0);
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* current = display + (y * width);
+        const uint8_t* last = previous + (y * width);
+        if (std::memcmp(current, last, width) == 0)
+            continue;
+
+        for (int index = 0; index < row_bytes; index++)
+        {
+            const uint8_t* pixels = current + (index * 4);
+            const uint8_t* last_pixels = last + (index * 4);
+            row[index] = (uint8_t)(((pixels[0] ^ last_pixels[0]) & 3) | (((pixels[1] ^ last_pixels[1]) & 3) << 2) |
+                (((pixels[2] ^ last_pixels[2]) & 3) << 4) | (((pixels[3] ^ last_pixels[3]) & 3) << 6));
+        }
+
+        output[bitmap_offset + (y / 8)] |= (uint8_t)(1 << (y % 8));
+        pack_bits(row, row_bytes, output);
+        changed = true;
+    }
+
+    if (!changed)
+        output.resize(bitmap_offset);
+
+    return changed;
+}
+
+bool decode_display_delta(const uint8_t* payload, size_t size, int width, int height, uint8_t* display)
+{
+    const int row_bytes = width / 4;
+    const size_t bitmap_size = (height + 7) / 8;
+    if (size < bitmap_size || row_bytes > MaxRowBytes)
+        return false;
+
+    const uint8_t* input = payload + bitmap_size;
+    const uint8_t* end = payload + size;
+    uint8_t row[MaxRowBytes];
+
+    for (int y = 0; y < height; y++)
+    {
+        if (((payload[y / 8] >> (y % 8)) & 1) == 0)
+            continue;
+
+        if (!unpack_bits(input, end, row, row_bytes))
+            return false;
+
+        uint8_t* pixels = display + (y * width);
+        for (int x = 0; x < width; x++)
+            pixels[x] ^= (row[x / 4] >> ((x % 4) * 2)) & 3;
+    }
+
+    return input == end;
+}
+
+std::string capture_file_name(const std::string& path, const std::string& suffix)
+{
+    const size_t separator = path.find_last_of("/\\");
+    const size_t dot = path.find_last_of('.');
+    const size_t split = (dot != std::string::npos && (separator == std::string::npos || dot > separator)) ? dot : path.size();
+
+    return path.substr(0, split) + suffix + path.substr(split);
+}
+
+CaptureWriter::CaptureWriter(size_t max_queued_chunks)
+    : m_max_queued_chunks(max_queued_chunks)
+{
+    m_thread = std::thread(&CaptureWriter::thread_main, this);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_queue_ready.notify_one();
+    m_thread.join();
+
+    for (FILE* stream : m_streams)
+    {
+        if (stream)
+            std::fclose(stream);
+    }
+}
+
+int CaptureWriter::open_stream(const std::string& path, const CaptureHeader& header)
+{
+    FILE* stream = std::fopen(path.c_str(), "wb");
+    if (!stream)
+        return -1;
+
+    if (std::fwrite(&header, sizeof(header), 1, stream) != 1)
+    {
+        std::fclose(stream);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_streams.push_back(stream);
+    m_written_bytes += sizeof(header);
+
+    return (int)m_streams.size() - 1;
+}
+
+void CaptureWriter::close_stream(int stream)
+{
+    Item item;
+    item.stream = stream;
+    item.close = true;
+
+    // Closing is never dropped, it may go over the queue bound
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(item));
+    }
+
+    m_queue_ready.notify_one();
+}
+
+bool CaptureWriter::submit(int stream, std::vector<uint8_t>&& chunk, bool force)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!force && m_queue.size() >= m_max_queued_chunks)
+        {
+            m_dropped_chunks++;
+            chunk.clear();
+            m_free_buffers.push_back(std::move(chunk));
+            return false;
+        }
+
+        Item item;
+        item.stream = stream;
+        item.chunk = std::move(chunk);
+        m_queue.push_back(std::move(item));
+    }
+
+    m_queue_ready.notify_one();
+
+    return true;
+}
+
+std::vector<uint8_t> CaptureWriter::take_buffer()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free_buffers.empty())
+        return {};
+
+    std::vector<uint8_t> buffer = std::move(m_free_buffers.back());
+    m_free_buffers.pop_back();
+
+    return buffer;
+}
+
+void CaptureWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queue_drained.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+}
+
+uint64_t CaptureWriter::dropped_chunks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped_chunks;
+}
+
+uint64_t CaptureWriter::written_bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written_bytes;
+}
+
+void CaptureWriter::thread_main()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_queue_ready.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty())
+            break;
+
+        Item item = std::move(m_queue.front());
+        m_queue.pop_front();
+        FILE* stream = m_streams[item.stream];
+        m_busy = true;
+
+        // The file work happens without the lock, submit() never waits for the disk
+        lock.unlock();
+
+        size_t written = 0;
+        if (stream && !item.chunk.empty())
+            written = std::fwrite(item.chunk.data(), 1, item.chunk.size(), stream);
+        if (stream && item.close)
+            std::fclose(stream);
+
+        lock.lock();
+
+        m_busy = false;
+        m_written_bytes += written;
+        if (item.close)
+            m_streams[item.stream] = nullptr;
+
+        if (!item.chunk.empty())
+        {
+            item.chunk.clear();
+            m_free_buffers.push_back(std::move(item.chunk));
+        }
+
+        if (m_queue.empty())
+            m_queue_drained.notify_all();
+    }
+}
+
+CaptureEncoder::CaptureEncoder()
+{
+}
+
+CaptureEncoder::~CaptureEncoder()
+{
+    close();
+}
+
+bool CaptureEncoder::open(CaptureWriter& writer, const std::string& path, int width, int height, int planes)
+{
+    close();
+
+    if ((width % 4) != 0 || width / 4 > MaxRowBytes)
+        return false;
+
+    CaptureHeader header;
+    header.width = (uint16_t)width;
+    header.height = (uint16_t)height;
+    header.planes = (uint8_t)planes;
+
+    m_stream = writer.open_stream(path, header);
+    if (m_stream < 0)
+        return false;
+
+    m_writer = &writer;
+    m_width = width;
+    m_height = height;
+    m_frames = 0;
+    m_frames_since_key_frame = 0;
+    m_gap = false;
+    m_previous.assign((size_t)width * height, 0);
+    m_chunk = writer.take_buffer();
+    m_chunk.reserve(ChunkSize + sizeof(CaptureFrame) + m_previous.size());
+    m_last_record = -1;
+
+    return true;
+}
+
+void CaptureEncoder::close()
+{
+    if (!m_writer)
+        return;
+
+    // The tail of the capture is never dropped
+    submit_chunk(true);
+    m_writer->close_stream(m_stream);
+    m_writer = nullptr;
+    m_stream = -1;
+}
+
+void CaptureEncoder::add_frame(const uint8_t* display, uint8_t sound_timer, uint16_t keys)
+{
+    if (!m_writer)
+        return;
+
+    const bool key_frame = m_frames == 0 || m_gap || m_frames_since_key_frame >= KeyFrameInterval;
+    if (key_frame)
+        std::fill(m_previous.begin(), m_previous.end(), 0);
+
+    const size_t record = m_chunk.size();
+    m_chunk.resize(record + sizeof(CaptureFrame));
+    const bool changed = encode_display_delta(display, m_previous.data(), m_width, m_height, m_chunk);
+
+    CaptureFrame frame;
+    frame.keys = keys;
+    frame.sound_timer = sound_timer;
+    frame.flags = (changed ? CaptureFlag::DisplayChanged : 0) | (key_frame ? CaptureFlag::KeyFrame : 0) | (m_gap ? CaptureFlag::Gap : 0);
+    frame.payload_size = (uint32_t)(m_chunk.size() - record - sizeof(CaptureFrame));
+
+    // An idle frame with the same input and sound extends the previous idle record
+    CaptureFrame last;
+    if (frame.flags == 0 && m_last_record >= 0)
+    {
+        std::memcpy(&last, m_chunk.data() + m_last_record, sizeof(last));
+
+        if ((last.flags & ~CaptureFlag::Repeat) == 0 && last.keys == keys && last.sound_timer == sound_timer)
+        {
+            last.payload_size = (last.flags & CaptureFlag::Repeat) ? last.payload_size + 1 : 1;
+            last.flags = CaptureFlag::Repeat;
+            std::memcpy(m_chunk.data() + m_last_record, &last, sizeof(last));
+            m_chunk.resize(record);
+            frame.flags = CaptureFlag::Repeat;
+        }
+    }
+
+    if (frame.flags != CaptureFlag::Repeat)
+    {
+        std::memcpy(m_chunk.data() + record, &frame, sizeof(frame));
+        m_last_record = (ptrdiff_t)record;
+    }
+
+    if (changed)
+        std::memcpy(m_previous.data(), display, m_previous.size());
+
+    m_frames++;
+    m_frames_since_key_frame = key_frame ? 1 : m_frames_since_key_frame + 1;
+    m_gap = false;
+
+    if (m_chunk.size() >= ChunkSize)
+        submit_chunk();
+}
+
+void CaptureEncoder::submit_chunk(bool force)
+{
+    if (m_chunk.empty())
+        return;
+
+    // A dropped chunk breaks the delta chain, the next frame restarts from a key frame
+    if (!m_writer->submit(m_stream, std::move(m_chunk), force))
+        m_gap = true;
+
+    m_chunk = m_writer->take_buffer();
+    m_last_record = -1;
+}
+
+bool CaptureReader::open(const std::string& path)
+{
+    if (!m_file.open(path) || m_file.size() < sizeof(CaptureHeader))
+        return false;
+
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (m_header.magic != CaptureMagic || m_header.version != CaptureVersion || (m_header.width % 4) != 0 || m_header.width / 4 > MaxRowBytes)
+    {
+        m_file.close();
+        return false;
+    }
+
+    m_offset = sizeof(CaptureHeader);
+    m_index = 0;
+    m_repeats_left = 0;
+    m_display.assign((size_t)m_header.width * m_header.height, 0);
+
+    return true;
+}
+
+bool CaptureReader::next_frame(Frame& frame)
+{
+    if (m_repeats_left > 0)
+    {
+        m_repeats_left--;
+        m_last_frame.index = m_index++;
+        frame = m_last_frame;
+        return true;
+    }
+
+    if (!m_file.is_open() || m_file.size() - m_offset < sizeof(CaptureFrame))
+        return false;
+
+    CaptureFrame record;
+    std::memcpy(&record, m_file.data() + m_offset, sizeof(record));
+    m_offset += sizeof(record);
+
+    if (record.flags & CaptureFlag::Repeat)
+    {
+        m_repeats_left = record.payload_size;
+    }
+    else
+    {
+        if (m_file.size() - m_offset < record.payload_size)
+            return false;
+
+        if (record.flags & CaptureFlag::KeyFrame)
+            std::fill(m_display.begin(), m_display.end(), 0);
+
+        if ((record.flags & CaptureFlag::DisplayChanged) &&
+            !decode_display_delta(m_file.data() + m_offset, record.payload_size, m_header.width, m_header.height, m_display.data()))
+            return false;
+
+        m_offset += record.payload_size;
+    }
+
+    m_last_frame.index = m_index++;
+    m_last_frame.keys = record.keys;
+    m_last_frame.sound_timer = record.sound_timer;
+    m_last_frame.flags = record.flags & ~CaptureFlag::Repeat;
+    frame = m_last_frame;
+
+    return true;
+}
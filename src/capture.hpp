@@ -0,0 +1,181 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Session capture file (little endian):
+//   CaptureHeader
+//   CaptureFrame records, each followed by payload_size bytes of display delta
+//
+// A display delta is a bitmap of the rows that differ from the previous frame (one bit
+// per row, LSB first), then for each of those rows its XOR against the previous frame,
+// packed to 2 bits per pixel and PackBits run-length encoded. Key frames are deltas
+// against a blank display. Consecutive identical records collapse into one with
+// CaptureFlag::Repeat, whose payload_size is then the number of extra frames.
+
+static inline constexpr uint32_t CaptureMagic = 0x50433843; // "C8CP"
+static inline constexpr uint32_t CaptureVersion = 1;
+
+struct CaptureHeader
+{
+    uint32_t magic = CaptureMagic;
+    uint32_t version = CaptureVersion;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint8_t planes = 1;
+    uint8_t frames_per_second = 60;
+    uint16_t reserved = 0;
+};
+
+struct CaptureFrame
+{
+    uint16_t keys = 0;
+    uint8_t sound_timer = 0;
+    uint8_t flags = 0;
+    uint32_t payload_size = 0;
+};
+
+static_assert(sizeof(CaptureHeader) == 16, "Unexpected CaptureHeader layout");
+static_assert(sizeof(CaptureFrame) == 8, "Unexpected CaptureFrame layout");
+
+namespace CaptureFlag
+{
+    static inline constexpr uint8_t DisplayChanged = 1 << 0;
+    static inline constexpr uint8_t KeyFrame = 1 << 1;
+    // Frames before this one were dropped because the writer queue was full
+    static inline constexpr uint8_t Gap = 1 << 2;
+    static inline constexpr uint8_t Repeat = 1 << 3;
+}
+
+// Appends the delta from previous to display, returns false when no row changed
+bool encode_display_delta(const uint8_t* display, const uint8_t* previous, int width, int height, std::vector<uint8_t>& output);
+// Applies a delta to display in place
+bool decode_display_delta(const uint8_t* payload, size_t size, int width, int height, uint8_t* display);
+// Inserts suffix before the file extension, "session.c8c" + "_0001" gives "session_0001.c8c"
+std::string capture_file_name(const std::string& path, const std::string& suffix);
+
+// Writes chunks for any number of capture files from one background thread. The queue
+// is bounded, a full queue drops the chunk instead of blocking the emulation thread.
+class CaptureWriter
+{
+public:
+    explicit CaptureWriter(size_t max_queued_chunks = 256);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // Creates the file and writes the header synchronously, returns -1 on failure
+    int open_stream(const std::string& path, const CaptureHeader& header);
+    void close_stream(int stream);
+
+    // Returns false and drops the chunk when the queue is full, unless forced
+    bool submit(int stream, std::vector<uint8_t>&& chunk, bool force = false);
+    // Recycled chunk buffers, avoids an allocation per chunk
+    std::vector<uint8_t> take_buffer();
+    // Waits until everything queued so far is written
+    void flush();
+
+    uint64_t dropped_chunks() const;
+    uint64_t written_bytes() const;
+
+private:
+    struct Item
+    {
+        int stream = -1;
+        bool close = false;
+        std::vector<uint8_t> chunk;
+    };
+
+    const size_t m_max_queued_chunks;
+    std::vector<FILE*> m_streams;
+    std::deque<Item> m_queue;
+    std::vector<std::vector<uint8_t>> m_free_buffers;
+    bool m_busy = false;
+    bool m_stop = false;
+    uint64_t m_dropped_chunks = 0;
+    uint64_t m_written_bytes = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_queue_ready;
+    std::condition_variable m_queue_drained;
+    std::thread m_thread;
+
+    void thread_main();
+};
+
+// Turns the presented frames of one machine into a capture stream
+class CaptureEncoder
+{
+public:
+    CaptureEncoder();
+    ~CaptureEncoder();
+
+    CaptureEncoder(const CaptureEncoder&) = delete;
+    CaptureEncoder& operator=(const CaptureEncoder&) = delete;
+
+    bool open(CaptureWriter& writer, const std::string& path, int width, int height, int planes);
+    void close();
+    bool is_open() const { return m_writer != nullptr; }
+
+    void add_frame(const uint8_t* display, uint8_t sound_timer, uint16_t keys);
+    uint64_t frames() const { return m_frames; }
+
+private:
+    CaptureWriter* m_writer = nullptr;
+    int m_stream = -1;
+    int m_width = 0;
+    int m_height = 0;
+    uint64_t m_frames = 0;
+    int m_frames_since_key_frame = 0;
+    bool m_gap = false;
+
+    std::vector<uint8_t> m_previous;
+    std::vector<uint8_t> m_chunk;
+    // Offset of the last record in m_chunk, -1 when the chunk has none to extend
+    ptrdiff_t m_last_record = -1;
+
+    static inline constexpr size_t ChunkSize = 64 * 1024;
+    static inline constexpr int KeyFrameInterval = 600;
+
+    void submit_chunk(bool force = false);
+};
+
+// Decodes a capture file frame by frame
+class CaptureReader
+{
+public:
+    struct Frame
+    {
+        uint64_t index = 0;
+        uint16_t keys = 0;
+        uint8_t sound_timer = 0;
+        uint8_t flags = 0;
+    };
+
+    bool open(const std::string& path);
+    const CaptureHeader& header() const { return m_header; }
+    size_t file_size() const { return m_file.size(); }
+
+    // Decodes the next frame into display(), false at the end or on a corrupt record
+    bool next_frame(Frame& frame);
+    const uint8_t* display() const { return m_display.data(); }
+
+private:
+    MappedFile m_file;
+    CaptureHeader m_header;
+    size_t m_offset = 0;
+    uint64_t m_index = 0;
+    uint32_t m_repeats_left = 0;
+    Frame m_last_frame;
+    std::vector<uint8_t> m_display;
+};
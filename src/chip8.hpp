@@ -1,29 +1,26 @@
 #pragma once
 
-#include "sound.hpp"
+#include "platform.hpp"
+
 #include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
 
-class CHIP8
+// State and tables shared by every platform variant
+class CHIP8Base
 {
 public:
-    CHIP8();
-
-    bool init();
-    void reset();
-    void execute();
-    void update_timers();
-    bool load_rom_in_memory(const char* rom, uint32_t size);
-    bool display_updated() { return m_display_updated; }
-    void display_rendered() { m_display_updated = false; }
-    const uint8_t* get_display() const { return m_display; }
-
-    static inline constexpr auto MemorySize = 4096;
     static inline constexpr auto StackSize = 16;
+    static inline constexpr auto StackMask = StackSize - 1;
     static inline constexpr auto FontSize = 80;
+    static inline constexpr auto BigFontSize = 160;
+    static inline constexpr auto FontAddress = 0x000;
+    static inline constexpr auto BigFontAddress = FontAddress + FontSize;
     static inline constexpr auto ResetVector = 0x200;
-    static inline constexpr auto DisplayWidth = 64;
-    static inline constexpr auto DisplayHeight = 32;
     static inline constexpr auto KeyCount = 16;
+    static inline constexpr auto AudioPatternSize = 16;
 
     struct Registers
     {
@@ -43,6 +40,91 @@ public:
         uint16_t nnn = 0x0000;
     };
 
+protected:
+    static const uint8_t m_font[FontSize];
+    static const uint8_t m_big_font[BigFontSize];
+
+    // Zobrist keys are derived with the splitmix64 finalizer instead of a table,
+    // a 64 KB memory would need 16 MB of keys
+    static constexpr uint64_t zobrist_key(uint64_t value)
+    {
+        value += 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    static constexpr uint64_t memory_key(uint32_t address, uint8_t value) { return zobrist_key(((uint64_t)1 << 40) | ((uint64_t)address << 8) | value); }
+    static constexpr uint64_t pixel_key(uint32_t index, int plane) { return zobrist_key(((uint64_t)2 << 40) | ((uint64_t)index << 2) | plane); }
+    static constexpr uint64_t register_key(uint32_t slot, uint32_t value) { return zobrist_key(((uint64_t)3 << 40) | ((uint64_t)slot << 32) | value); }
+};
+
+// Receives execution and memory accesses from cores instantiated with Feature::Debugger,
+// other instantiations never reference it
+class DebugHooks
+{
+public:
+    virtual ~DebugHooks() = default;
+
+    // Before the instruction at registers.PC, true stops without executing it
+    virtual bool break_before(const CHIP8Base::Registers& registers) = 0;
+    // After every instruction, true stops after it
+    virtual bool break_after(const CHIP8Base::Registers& registers) = 0;
+    // Data accesses only, instruction fetches are not reported
+    virtual void memory_read(uint16_t address, uint8_t value) = 0;
+    virtual void memory_written(uint16_t address, uint8_t value) = 0;
+};
+
+// CHIP-8 core specialized at compile time for a platform/quirk policy (see platform.hpp).
+// Display size, memory size and every quirk check are constants of the instantiation.
+template <typename Platform, uint32_t Features = 0>
+class CHIP8 : public CHIP8Base
+{
+public:
+    CHIP8();
+
+    void reset();
+    void execute();
+    void run(int cycles);
+    void update_timers();
+    bool load_rom_in_memory(const char* rom, uint32_t size);
+    // Copies data into memory and leaves the rest of the state alone, e.g. a ROM over a pristine snapshot
+    bool write_memory(uint32_t address, const uint8_t* data, uint32_t size);
+    void set_keys(uint16_t keys) { m_keys = keys; }
+    void seed(uint32_t value) { m_random_state = value ? value : 1; }
+    bool display_updated() const { return m_display_updated; }
+    void display_rendered() { m_display_updated = false; }
+    const uint8_t* get_display() const { return m_display; }
+    const uint8_t* get_memory() const { return m_memory; }
+    const Registers& get_registers() const { return m_registers; }
+    const uint16_t* get_stack() const { return m_stack; }
+    uint8_t get_delay_timer() const { return m_delay_timer; }
+    uint8_t get_sound_timer() const { return m_sound_timer; }
+    bool sound_active() const { return m_sound_timer > 0; }
+    bool halted() const { return m_halted; }
+    const uint8_t* get_audio_pattern() const { return m_audio_pattern_loaded ? m_audio_pattern : nullptr; }
+    uint8_t get_audio_pitch() const { return m_audio_pitch; }
+    void attach_debugger(DebugHooks* hooks) { m_debug_hooks = hooks; }
+
+    // Identical states hash identically whatever path led to them. Only O(1) when the
+    // core is instantiated with Feature::StateHash, otherwise they fall back to a full recompute.
+    uint64_t state_hash() const;
+    uint64_t display_hash() const;
+    uint64_t recompute_state_hash() const;
+    uint64_t recompute_display_hash() const;
+
+    static inline constexpr auto MemorySize = Platform::MemorySize;
+    static inline constexpr auto AddressMask = MemorySize - 1;
+    static inline constexpr auto DisplayWidth = Platform::DisplayWidth;
+    static inline constexpr auto DisplayHeight = Platform::DisplayHeight;
+    static inline constexpr bool StateHashing = (Features & Feature::StateHash) != 0;
+    static inline constexpr bool VerifyStateHashing = (Features & Feature::VerifyStateHash) == Feature::VerifyStateHash;
+    static inline constexpr bool Debugging = (Features & Feature::Debugger) != 0;
+
+    static_assert((MemorySize & AddressMask) == 0, "Memory size must be a power of two");
+    static_assert((StackSize & StackMask) == 0, "Stack size must be a power of two");
+    static_assert(Platform::HighResolution || (DisplayWidth == 64 && DisplayHeight == 32), "Low resolution platforms are 64x32");
+
 private:
     Registers m_registers;
     Opcode m_opcode;
@@ -50,23 +132,846 @@ private:
     uint16_t m_stack[StackSize] = { 0 };
     uint8_t m_delay_timer = 0;
     uint8_t m_sound_timer = 0;
-    static uint8_t m_font[FontSize];
+    uint16_t m_keys = 0;
     uint8_t m_display[DisplayWidth * DisplayHeight] = { 0 };
     bool m_display_updated = false;
-    static int m_keymap[KeyCount];
-
-    Sound m_sound_device;
+    bool m_hires = false;
+    bool m_halted = false;
+    uint8_t m_plane_mask = 1;
+    uint8_t m_flag_registers[16] = { 0 };
+    uint8_t m_audio_pattern[AudioPatternSize] = { 0 };
+    bool m_audio_pattern_loaded = false;
+    uint8_t m_audio_pitch = 64;
+    uint32_t m_random_state = 1;
+    uint64_t m_memory_hash = 0;
+    uint64_t m_display_hash = 0;
+    DebugHooks* m_debug_hooks = nullptr;
 
     void stack_push(uint16_t value);
     uint16_t stack_pop();
 
     uint8_t read(uint16_t address);
     uint16_t read_word(uint16_t address);
+    uint16_t fetch_word(uint16_t address) const;
     void write(uint16_t address, uint8_t value);
 
     void memory_cleanup();
+    uint64_t recompute_memory_hash() const;
+    uint64_t registers_hash() const;
+    void rehash_display();
+    uint8_t random();
+    void skip();
+    void clear_display();
+    void scroll_display(int dx, int dy);
     void draw_pixel();
     bool wait_key_press();
+    void verify_state_hash() const;
     void fetch();
     void execute_instruction();
 };
+
+template <typename Platform, uint32_t Features>
+CHIP8<Platform, Features>::CHIP8()
+{
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::reset()
+{
+    m_registers.PC = ResetVector;
+    m_registers.SP = 0x00;
+    m_registers.I = 0x00;
+    m_delay_timer = 0;
+    m_sound_timer = 0;
+
+    m_opcode.type = 0;
+    m_opcode.x = 0;
+    m_opcode.y = 0;
+    m_opcode.n = 0;
+    m_opcode.kk = 0;
+    m_opcode.nnn = 0;
+
+    for (int index = 0; index < 16; index++)
+        m_registers.V[index] = 0x00;
+
+    m_hires = false;
+    m_halted = false;
+    m_plane_mask = 1;
+    m_audio_pattern_loaded = false;
+    m_audio_pitch = 64;
+
+    std::memset(m_stack, 0x00, sizeof(m_stack));
+    std::memset(m_display, 0x00, sizeof(m_display));
+    m_display_updated = true;
+
+    if constexpr (StateHashing)
+    {
+        m_memory_hash = recompute_memory_hash();
+        rehash_display();
+    }
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::execute()
+{
+    if (m_halted)
+        return;
+
+    if constexpr (Debugging)
+    {
+        if (m_debug_hooks && m_debug_hooks->break_before(m_registers))
+            return;
+    }
+
+    fetch();
+    execute_instruction();
+
+    if constexpr (Debugging)
+    {
+        if (m_debug_hooks)
+            m_debug_hooks->break_after(m_registers);
+    }
+
+    if constexpr (VerifyStateHashing)
+        verify_state_hash();
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::run(int cycles)
+{
+    for (int cycle = 0; cycle < cycles && !m_halted; cycle++)
+    {
+        if constexpr (Debugging)
+        {
+            if (m_debug_hooks && m_debug_hooks->break_before(m_registers))
+                return;
+        }
+
+        fetch();
+        execute_instruction();
+
+        if constexpr (Debugging)
+        {
+            if (m_debug_hooks && m_debug_hooks->break_after(m_registers))
+                return;
+        }
+
+        if constexpr (VerifyStateHashing)
+            verify_state_hash();
+    }
+}
+
+template <typename Platform, uint32_t Features>
+bool CHIP8<Platform, Features>::load_rom_in_memory(const char* rom, uint32_t size)
+{
+    assert(rom || size == 0);
+    if ((MemorySize - ResetVector) < size)
+        return false;
+
+    memory_cleanup();
+
+    if (size > 0)
+        std::memcpy(m_memory + ResetVector, rom, size);
+
+    reset();
+
+    return true;
+}
+
+template <typename Platform, uint32_t Features>
+bool CHIP8<Platform, Features>::write_memory(uint32_t address, const uint8_t* data, uint32_t size)
+{
+    assert(data || size == 0);
+    if (address > MemorySize || (MemorySize - address) < size)
+        return false;
+
+    if constexpr (StateHashing)
+    {
+        for (uint32_t offset = 0; offset < size; offset++)
+            m_memory_hash ^= memory_key(address + offset, m_memory[address + offset]) ^ memory_key(address + offset, data[offset]);
+    }
+
+    if (size > 0)
+        std::memcpy(m_memory + address, data, size);
+
+    return true;
+}
+
+// Like memory accesses, the stack pointer wraps around instead of running off the stack
+// on unbalanced calls and returns
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::stack_push(uint16_t value)
+{
+    m_stack[m_registers.SP & StackMask] = value;
+    m_registers.SP = (m_registers.SP + 1) & StackMask;
+}
+
+template <typename Platform, uint32_t Features>
+uint16_t CHIP8<Platform, Features>::stack_pop()
+{
+    m_registers.SP = (m_registers.SP - 1) & StackMask;
+    return m_stack[m_registers.SP];
+}
+
+template <typename Platform, uint32_t Features>
+uint8_t CHIP8<Platform, Features>::read(uint16_t address)
+{
+    const uint8_t value = m_memory[address & AddressMask];
+
+    if constexpr (Debugging)
+    {
+        if (m_debug_hooks)
+            m_debug_hooks->memory_read(address & AddressMask, value);
+    }
+
+    return value;
+}
+
+template <typename Platform, uint32_t Features>
+uint16_t CHIP8<Platform, Features>::read_word(uint16_t address)
+{
+    return (read(address) << 8 | read(address + 1));
+}
+
+template <typename Platform, uint32_t Features>
+uint16_t CHIP8<Platform, Features>::fetch_word(uint16_t address) const
+{
+    return (m_memory[address & AddressMask] << 8 | m_memory[(address + 1) & AddressMask]);
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::write(uint16_t address, uint8_t value)
+{
+    uint8_t& cell = m_memory[address & AddressMask];
+
+    if constexpr (StateHashing)
+        m_memory_hash ^= memory_key(address & AddressMask, cell) ^ memory_key(address & AddressMask, value);
+
+    cell = value;
+
+    if constexpr (Debugging)
+    {
+        if (m_debug_hooks)
+            m_debug_hooks->memory_written(address & AddressMask, value);
+    }
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::memory_cleanup()
+{
+    std::memset(m_memory, 0x00, sizeof(m_memory));
+
+    // Copy font data
+    std::memcpy(m_memory + FontAddress, m_font, FontSize);
+    if constexpr (Platform::HighResolution)
+        std::memcpy(m_memory + BigFontAddress, m_big_font, BigFontSize);
+}
+
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::recompute_memory_hash() const
+{
+    uint64_t hash = 0;
+    for (uint32_t address = 0; address < MemorySize; address++)
+        hash ^= memory_key(address, m_memory[address]);
+
+    return hash;
+}
+
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::recompute_display_hash() const
+{
+    uint64_t hash = 0;
+    for (uint32_t index = 0; index < (DisplayWidth * DisplayHeight); index++)
+    {
+        for (int plane = 0; plane < Platform::Planes; plane++)
+        {
+            if ((m_display[index] >> plane) & 1)
+                hash ^= pixel_key(index, plane);
+        }
+    }
+
+    return hash;
+}
+
+// Registers are a fixed handful of bytes, folding them in on demand keeps state_hash()
+// O(1) without touching every register write in the interpreter loop
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::registers_hash() const
+{
+    uint64_t hash = 0;
+    uint32_t slot = 0;
+
+    for (int index = 0; index < 16; index++)
+        hash ^= register_key(slot++, m_registers.V[index]);
+    for (int index = 0; index < StackSize; index++)
+        hash ^= register_key(slot++, m_stack[index]);
+    for (int index = 0; index < 16; index++)
+        hash ^= register_key(slot++, m_flag_registers[index]);
+    for (int index = 0; index < AudioPatternSize; index++)
+        hash ^= register_key(slot++, m_audio_pattern[index]);
+
+    hash ^= register_key(slot++, m_registers.PC);
+    hash ^= register_key(slot++, m_registers.SP);
+    hash ^= register_key(slot++, m_registers.I);
+    hash ^= register_key(slot++, m_delay_timer);
+    hash ^= register_key(slot++, m_sound_timer);
+    hash ^= register_key(slot++, m_random_state);
+    hash ^= register_key(slot++, m_plane_mask | (m_hires << 8) | (m_halted << 9) | (m_audio_pattern_loaded << 10) | (m_audio_pitch << 16));
+
+    return hash;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::rehash_display()
+{
+    if constexpr (StateHashing)
+        m_display_hash = recompute_display_hash();
+}
+
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::state_hash() const
+{
+    if constexpr (StateHashing)
+        return m_memory_hash ^ m_display_hash ^ registers_hash();
+    else
+        return recompute_state_hash();
+}
+
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::display_hash() const
+{
+    if constexpr (StateHashing)
+        return m_display_hash;
+    else
+        return recompute_display_hash();
+}
+
+template <typename Platform, uint32_t Features>
+uint64_t CHIP8<Platform, Features>::recompute_state_hash() const
+{
+    return recompute_memory_hash() ^ recompute_display_hash() ^ registers_hash();
+}
+
+// Not an assert, instantiating the check is the request for it and release builds run it too
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::verify_state_hash() const
+{
+    if (state_hash() != recompute_state_hash())
+    {
+        std::fprintf(stderr, "State hash mismatch after opcode %03X at PC %03X\n", m_opcode.nnn | (m_opcode.type << 12), m_registers.PC);
+        std::abort();
+    }
+}
+
+// xorshift32, kept in the core so snapshots replay the same random sequence
+template <typename Platform, uint32_t Features>
+uint8_t CHIP8<Platform, Features>::random()
+{
+    m_random_state ^= m_random_state << 13;
+    m_random_state ^= m_random_state >> 17;
+    m_random_state ^= m_random_state << 5;
+
+    return (uint8_t)(m_random_state >> 24);
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::skip()
+{
+    // XO-CHIP skips over the whole double width F000 NNNN instruction
+    if constexpr (Platform::Extended)
+    {
+        if (fetch_word(m_registers.PC) == 0xF000)
+            m_registers.PC += 2;
+    }
+
+    m_registers.PC += 2;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::clear_display()
+{
+    if constexpr (Platform::Planes == 1)
+    {
+        std::memset(m_display, 0x00, sizeof(m_display));
+    }
+    else
+    {
+        for (int index = 0; index < (DisplayWidth * DisplayHeight); index++)
+            m_display[index] &= ~m_plane_mask;
+    }
+
+    rehash_display();
+    m_display_updated = true;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::scroll_display(int dx, int dy)
+{
+    uint8_t previous[DisplayWidth * DisplayHeight];
+    std::memcpy(previous, m_display, sizeof(m_display));
+
+    for (int y = 0; y < DisplayHeight; y++)
+    {
+        for (int x = 0; x < DisplayWidth; x++)
+        {
+            int source_x = x - dx;
+            int source_y = y - dy;
+            uint8_t pixel = 0;
+
+            if (source_x >= 0 && source_x < DisplayWidth && source_y >= 0 && source_y < DisplayHeight)
+                pixel = previous[source_x + (source_y * DisplayWidth)];
+
+            uint8_t& target = m_display[x + (y * DisplayWidth)];
+            target = (target & ~m_plane_mask) | (pixel & m_plane_mask);
+        }
+    }
+
+    rehash_display();
+    m_display_updated = true;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::draw_pixel()
+{
+    // In low resolution mode a high resolution display draws every pixel as a 2x2 block
+    int scale = 1;
+    if constexpr (Platform::HighResolution)
+        scale = m_hires ? 1 : 2;
+
+    // The start position always wraps, the pixels past the edges are clipped or wrapped per quirk
+    const int width = DisplayWidth / scale;
+    const int height = DisplayHeight / scale;
+    const int x = m_registers.V[m_opcode.x] % width;
+    const int y = m_registers.V[m_opcode.y] % height;
+
+    int rows = m_opcode.n;
+    int columns = 8;
+    if constexpr (Platform::HighResolution)
+    {
+        if (rows == 0)
+        {
+            rows = 16;
+            columns = 16;
+        }
+    }
+
+    uint16_t address = m_registers.I;
+    m_registers.V[0xF] = 0;
+
+    for (int plane = 0; plane < Platform::Planes; plane++)
+    {
+        const uint8_t plane_bit = 1 << plane;
+        if ((m_plane_mask & plane_bit) == 0)
+            continue;
+
+        for (int row = 0; row < rows; row++)
+        {
+            uint16_t data = (columns == 16) ? read_word(address + (row * 2)) : (read(address + row) << 8);
+
+            int pixel_y = y + row;
+            if (pixel_y >= height)
+            {
+                if constexpr (Platform::WrapSprites)
+                    pixel_y -= height;
+                else
+                    break;
+            }
+
+            for (int column = 0; column < columns; column++, data <<= 1)
+            {
+                if ((data & 0x8000) == 0)
+                    continue;
+
+                int pixel_x = x + column;
+                if (pixel_x >= width)
+                {
+                    if constexpr (Platform::WrapSprites)
+                        pixel_x -= width;
+                    else
+                        break;
+                }
+
+                for (int dy = 0; dy < scale; dy++)
+                {
+                    const int line = ((pixel_y * scale + dy) * DisplayWidth) + (pixel_x * scale);
+                    for (int dx = 0; dx < scale; dx++)
+                    {
+                        if ((m_display[line + dx] & plane_bit) != 0)
+                            m_registers.V[0xF] = 1;
+                        m_display[line + dx] ^= plane_bit;
+
+                        if constexpr (StateHashing)
+                            m_display_hash ^= pixel_key(line + dx, plane);
+                    }
+                }
+            }
+        }
+
+        address += rows * (columns / 8);
+    }
+
+    m_display_updated = true;
+}
+
+template <typename Platform, uint32_t Features>
+bool CHIP8<Platform, Features>::wait_key_press()
+{
+    bool key_pressed = false;
+
+    for (int index = 0; index < KeyCount; index++)
+    {
+        if ((m_keys >> index) & 1)
+        {
+            m_registers.V[m_opcode.x] = index;
+            key_pressed = true;
+        }
+    }
+
+    return key_pressed;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::fetch()
+{
+    uint16_t value = fetch_word(m_registers.PC);
+
+    // Decode instruction
+    m_opcode.type = (value >> 12) & 0x000F;
+    m_opcode.x = (value >> 8) & 0x000F;
+    m_opcode.y = (value >> 4) & 0x000F;
+    m_opcode.n = value & 0x000F;
+    m_opcode.kk = value & 0x00FF;
+    m_opcode.nnn = value & 0x0FFF;
+
+    // Increment program counter
+    m_registers.PC += 2;
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::execute_instruction()
+{
+    auto& V = m_registers.V;
+
+    switch (m_opcode.type)
+    {
+    case 0x0:
+        switch (m_opcode.nnn)
+        {
+        case 0x0E0:
+            clear_display();
+            break;
+
+        case 0x00EE:
+            m_registers.PC = stack_pop();
+            break;
+
+        case 0x0FB:
+            if constexpr (Platform::HighResolution)
+                scroll_display(m_hires ? 4 : 8, 0);
+            break;
+
+        case 0x0FC:
+            if constexpr (Platform::HighResolution)
+                scroll_display(m_hires ? -4 : -8, 0);
+            break;
+
+        case 0x0FD:
+            if constexpr (Platform::HighResolution)
+                m_halted = true;
+            break;
+
+        case 0x0FE:
+        case 0x0FF:
+            if constexpr (Platform::HighResolution)
+            {
+                m_hires = (m_opcode.nnn == 0x0FF);
+                std::memset(m_display, 0x00, sizeof(m_display));
+                rehash_display();
+                m_display_updated = true;
+            }
+            break;
+
+        default:
+            if constexpr (Platform::HighResolution)
+            {
+                // 00CN scrolls down, XO-CHIP 00DN scrolls up
+                const int lines = m_hires ? m_opcode.n : (m_opcode.n * 2);
+                if ((m_opcode.nnn & 0xFF0) == 0x0C0)
+                    scroll_display(0, lines);
+                else if (Platform::Extended && (m_opcode.nnn & 0xFF0) == 0x0D0)
+                    scroll_display(0, -lines);
+            }
+            break;
+        }
+        break;
+
+    case 0x1:
+        m_registers.PC = m_opcode.nnn;
+        break;
+
+    case 0x2:
+        stack_push(m_registers.PC);
+        m_registers.PC = m_opcode.nnn;
+        break;
+
+    case 0x3:
+        if (V[m_opcode.x] == m_opcode.kk)
+            skip();
+        break;
+
+    case 0x4:
+        if (V[m_opcode.x] != m_opcode.kk)
+            skip();
+        break;
+
+    case 0x5:
+        if constexpr (Platform::Extended)
+        {
+            // 5XY2 saves and 5XY3 loads the VX..VY range at I without moving I
+            if (m_opcode.n == 0x2 || m_opcode.n == 0x3)
+            {
+                const int step = (m_opcode.x <= m_opcode.y) ? 1 : -1;
+                const int count = std::abs((int)m_opcode.y - (int)m_opcode.x) + 1;
+                for (int index = 0; index < count; index++)
+                {
+                    const int reg = m_opcode.x + (index * step);
+                    if (m_opcode.n == 0x2)
+                        write(m_registers.I + index, V[reg]);
+                    else
+                        V[reg] = read(m_registers.I + index);
+                }
+                break;
+            }
+        }
+
+        if (V[m_opcode.x] == V[m_opcode.y])
+            skip();
+        break;
+
+    case 0x6:
+        V[m_opcode.x] = m_opcode.kk;
+        break;
+
+    case 0x7:
+        V[m_opcode.x] += m_opcode.kk;
+        break;
+
+    case 0x8:
+        switch (m_opcode.n)
+        {
+        case 0x0:
+            V[m_opcode.x] = V[m_opcode.y];
+            break;
+
+        case 0x1:
+            V[m_opcode.x] |= V[m_opcode.y];
+            break;
+
+        case 0x2:
+            V[m_opcode.x] &= V[m_opcode.y];
+            break;
+
+        case 0x3:
+            V[m_opcode.x] ^= V[m_opcode.y];
+            break;
+
+        // Flag is written last so VF can also be used as an operand
+        case 0x4:
+        {
+            uint16_t sum = (uint16_t)V[m_opcode.x] + (uint16_t)V[m_opcode.y];
+            V[m_opcode.x] = (uint8_t)sum;
+            V[0xF] = (sum > 0xFF) ? 1 : 0;
+            break;
+        }
+
+        // VF is the no borrow flag, equal operands do not borrow
+        case 0x5:
+        {
+            uint8_t flag = (V[m_opcode.x] >= V[m_opcode.y]) ? 1 : 0;
+            V[m_opcode.x] -= V[m_opcode.y];
+            V[0xF] = flag;
+            break;
+        }
+
+        case 0x6:
+        {
+            uint8_t source = Platform::ShiftUsesVX ? V[m_opcode.x] : V[m_opcode.y];
+            V[m_opcode.x] = source >> 1;
+            V[0xF] = source & 1;
+            break;
+        }
+
+        case 0x7:
+        {
+            uint8_t flag = (V[m_opcode.y] >= V[m_opcode.x]) ? 1 : 0;
+            V[m_opcode.x] = V[m_opcode.y] - V[m_opcode.x];
+            V[0xF] = flag;
+            break;
+        }
+
+        case 0xE:
+        {
+            uint8_t source = Platform::ShiftUsesVX ? V[m_opcode.x] : V[m_opcode.y];
+            V[m_opcode.x] = source << 1;
+            V[0xF] = (source >> 7) & 1;
+            break;
+        }
+        }
+        break;
+
+    case 0x9:
+        if (V[m_opcode.x] != V[m_opcode.y])
+            skip();
+        break;
+
+    case 0xA:
+        m_registers.I = m_opcode.nnn;
+        break;
+
+    case 0xB:
+        if constexpr (Platform::JumpUsesVX)
+            m_registers.PC = m_opcode.nnn + V[m_opcode.x];
+        else
+            m_registers.PC = m_opcode.nnn + V[0];
+        break;
+
+    case 0xC:
+        V[m_opcode.x] = random() & m_opcode.kk;
+        break;
+
+    case 0xD:
+        draw_pixel();
+        break;
+
+    case 0xE:
+        switch (m_opcode.kk)
+        {
+        case 0x9E:
+            if ((m_keys >> (V[m_opcode.x] & 15)) & 1)
+                skip();
+            break;
+
+        case 0xA1:
+            if (((m_keys >> (V[m_opcode.x] & 15)) & 1) == 0)
+                skip();
+            break;
+        }
+        break;
+
+    case 0xF:
+        switch (m_opcode.kk)
+        {
+        case 0x00:
+            // XO-CHIP F000 NNNN loads a 16 bit address into I
+            if constexpr (Platform::Extended)
+            {
+                if (m_opcode.x == 0)
+                {
+                    m_registers.I = fetch_word(m_registers.PC);
+                    m_registers.PC += 2;
+                }
+            }
+            break;
+
+        case 0x01:
+            if constexpr (Platform::Extended)
+                m_plane_mask = m_opcode.x & ((1 << Platform::Planes) - 1);
+            break;
+
+        case 0x02:
+            if constexpr (Platform::Extended)
+            {
+                for (int index = 0; index < AudioPatternSize; index++)
+                    m_audio_pattern[index] = read(m_registers.I + index);
+                m_audio_pattern_loaded = true;
+            }
+            break;
+
+        case 0x07:
+            V[m_opcode.x] = m_delay_timer;
+            break;
+
+        case 0x0A:
+            if (!wait_key_press())
+                m_registers.PC -= 2;
+            break;
+
+        case 0x15:
+            m_delay_timer = V[m_opcode.x];
+            break;
+
+        case 0x18:
+            m_sound_timer = V[m_opcode.x];
+            break;
+
+        // The I overflow flag is a CHIP-8 interpreter behaviour, SUPER-CHIP and XO-CHIP leave VF alone
+        case 0x1E:
+            if constexpr (Platform::Type == PlatformType::CHIP8)
+                V[0xF] = ((m_registers.I + V[m_opcode.x]) > 0xFFF) ? 1 : 0;
+            m_registers.I += V[m_opcode.x];
+            break;
+
+        // Only the low nibble of VX selects a digit
+        case 0x29:
+            m_registers.I = FontAddress + (V[m_opcode.x] & 0xF) * 5;
+            break;
+
+        case 0x30:
+            if constexpr (Platform::HighResolution)
+                m_registers.I = BigFontAddress + (V[m_opcode.x] & 0xF) * 10;
+            break;
+
+        case 0x33:
+            write(m_registers.I, V[m_opcode.x] / 100);
+            write(m_registers.I + 1, (V[m_opcode.x] % 100) / 10);
+            write(m_registers.I + 2, V[m_opcode.x] % 10);
+            break;
+
+        case 0x3A:
+            if constexpr (Platform::Extended)
+                m_audio_pitch = V[m_opcode.x];
+            break;
+
+        case 0x55:
+            for (int index = 0; index <= m_opcode.x; index++)
+                write(m_registers.I + index, V[index]);
+            if constexpr (!Platform::LoadStoreKeepsI)
+                m_registers.I += m_opcode.x + 1;
+            break;
+
+        case 0x65:
+            for (int index = 0; index <= m_opcode.x; index++)
+                V[index] = read(m_registers.I + index);
+            if constexpr (!Platform::LoadStoreKeepsI)
+                m_registers.I += m_opcode.x + 1;
+            break;
+
+        case 0x75:
+            if constexpr (Platform::FlagRegisterCount > 0)
+            {
+                for (int index = 0; index <= (m_opcode.x % Platform::FlagRegisterCount); index++)
+                    m_flag_registers[index] = V[index];
+            }
+            break;
+
+        case 0x85:
+            if constexpr (Platform::FlagRegisterCount > 0)
+            {
+                for (int index = 0; index <= (m_opcode.x % Platform::FlagRegisterCount); index++)
+                    V[index] = m_flag_registers[index];
+            }
+            break;
+        }
+        break;
+    }
+}
+
+template <typename Platform, uint32_t Features>
+void CHIP8<Platform, Features>::update_timers()
+{
+    if (m_delay_timer > 0)
+        m_delay_timer--;
+
+    if (m_sound_timer > 0)
+        m_sound_timer--;
+}
@@ -0,0 +1,183 @@
+#ifndef CHIP8_SHM_H
+#define CHIP8_SHM_H
+
+/*
+ * Shared memory interface to a headless core (chip8shm), Linux only.
+ *
+ * The server places the core itself inside a POSIX shared memory segment, so the
+ * display, registers and memory are read in place at the offsets published in the
+ * header. A step is a futex handshake on two sequence numbers:
+ *
+ *   client: write command, argument and keys, increment request, wake request
+ *   server: run the command, publish status, store response = request, wake response
+ *
+ * Both sides spin briefly before sleeping on the futex, keeping round trips in the
+ * microsecond range while a client steps in a tight loop.
+ */
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CHIP8_SHM_MAGIC 0x4D485338u /* "8SHM" */
+#define CHIP8_SHM_VERSION 1u
+#define CHIP8_SHM_SPIN_COUNT 4096
+
+enum chip8_shm_command
+{
+    CHIP8_SHM_STEP_FRAMES = 1, /* run argument frames: cycles per frame plus a timer tick each */
+    CHIP8_SHM_STEP_CYCLES = 2, /* run argument instructions */
+    CHIP8_SHM_RESET = 3,       /* reset and reload the ROM, argument is the new RNG seed */
+    CHIP8_SHM_QUIT = 4         /* stop the server and remove the segment */
+};
+
+/* Same layout as CHIP8Base::Registers */
+struct chip8_shm_registers
+{
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t i;
+    uint8_t v[16];
+};
+
+struct chip8_shm_header
+{
+    /* Written once by the server */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t segment_size;
+    uint32_t platform; /* 0 CHIP-8, 1 SUPER-CHIP, 2 XO-CHIP */
+    uint32_t quirks;
+    uint32_t display_width;
+    uint32_t display_height;
+    uint32_t display_planes;
+    uint32_t memory_size;
+    uint32_t cycles_per_frame;
+    /* Offsets from the start of the segment into the core */
+    uint32_t display_offset; /* display_width * display_height bytes, one bitplane mask per pixel */
+    uint32_t registers_offset;
+    uint32_t memory_offset;
+    uint8_t reserved0[12];
+
+    /* Written by the client */
+    uint32_t request;
+    uint32_t command;
+    uint32_t argument;
+    uint32_t keys; /* bit N set while key N is held */
+    uint8_t reserved1[48];
+
+    /* Written by the server before response */
+    uint32_t response;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t halted;
+    uint8_t display_updated;
+    uint64_t frame;
+    uint64_t state_hash;
+    uint64_t display_hash;
+    uint8_t reserved2[32];
+};
+
+static inline int chip8_shm_futex(uint32_t* word, int operation, uint32_t value)
+{
+    return (int)syscall(SYS_futex, word, operation, value, NULL, NULL, 0);
+}
+
+/* Waits until *word differs from value and returns the new value */
+static inline uint32_t chip8_shm_wait(uint32_t* word, uint32_t value)
+{
+    uint32_t current;
+    int spin;
+
+    for (;;)
+    {
+        for (spin = 0; spin < CHIP8_SHM_SPIN_COUNT; spin++)
+        {
+            current = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+            if (current != value)
+                return current;
+        }
+
+        chip8_shm_futex(word, FUTEX_WAIT, value);
+    }
+}
+
+static inline void chip8_shm_signal(uint32_t* word, uint32_t value)
+{
+    __atomic_store_n(word, value, __ATOMIC_RELEASE);
+    chip8_shm_futex(word, FUTEX_WAKE, 0x7FFFFFFF);
+}
+
+/* Maps the segment created by chip8shm, returns NULL on failure */
+static inline struct chip8_shm_header* chip8_shm_attach(const char* name)
+{
+    struct chip8_shm_header* header;
+    struct stat info;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct chip8_shm_header))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    header = (struct chip8_shm_header*)mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        return NULL;
+
+    if (header->magic != CHIP8_SHM_MAGIC || header->version != CHIP8_SHM_VERSION || header->segment_size != (uint32_t)info.st_size)
+    {
+        munmap(header, (size_t)info.st_size);
+        return NULL;
+    }
+
+    return header;
+}
+
+static inline void chip8_shm_detach(struct chip8_shm_header* header)
+{
+    munmap(header, header->segment_size);
+}
+
+/* Runs one command and waits for the server to finish it */
+static inline void chip8_shm_call(struct chip8_shm_header* header, uint32_t command, uint32_t argument)
+{
+    uint32_t request = header->request + 1;
+
+    header->command = command;
+    header->argument = argument;
+    chip8_shm_signal(&header->request, request);
+
+    while (chip8_shm_wait(&header->response, request - 1) != request)
+        ;
+}
+
+static inline void chip8_shm_set_keys(struct chip8_shm_header* header, uint16_t keys)
+{
+    __atomic_store_n(&header->keys, keys, __ATOMIC_RELAXED);
+}
+
+static inline const uint8_t* chip8_shm_display(const struct chip8_shm_header* header)
+{
+    return (const uint8_t*)header + header->display_offset;
+}
+
+static inline const struct chip8_shm_registers* chip8_shm_registers(const struct chip8_shm_header* header)
+{
+    return (const struct chip8_shm_registers*)((const uint8_t*)header + header->registers_offset);
+}
+
+static inline const uint8_t* chip8_shm_memory(const struct chip8_shm_header* header)
+{
+    return (const uint8_t*)header + header->memory_offset;
+}
+
+#endif
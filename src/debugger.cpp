@@ -0,0 +1,478 @@
+#include "debugger.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool DebugCondition::evaluate(const CHIP8Base::Registers& registers) const
+{
+    const uint16_t current = (target == IndexRegister) ? registers.I : registers.V[target & 0xF];
+
+    switch (op)
+    {
+    case Operator::Equal: return current == value;
+    case Operator::NotEqual: return current != value;
+    case Operator::Less: return current < value;
+    case Operator::LessEqual: return current <= value;
+    case Operator::Greater: return current > value;
+    case Operator::GreaterEqual: return current >= value;
+    }
+
+    return false;
+}
+
+std::string DebugCondition::to_string() const
+{
+    static const char* operators[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+    char text[32];
+    if (target == IndexRegister)
+        std::snprintf(text, sizeof(text), "I %s 0x%03X", operators[(int)op], value);
+    else
+        std::snprintf(text, sizeof(text), "V%X %s 0x%02X", target, operators[(int)op], value);
+
+    return text;
+}
+
+bool DebugCondition::parse(const std::string& text, DebugCondition& condition)
+{
+    std::string compact;
+    for (char character : text)
+    {
+        if (!std::isspace((unsigned char)character))
+            compact += (char)std::tolower((unsigned char)character);
+    }
+
+    size_t position = 0;
+    if (compact.size() >= 2 && compact[0] == 'v' && std::isxdigit((unsigned char)compact[1]))
+    {
+        condition.target = (int)std::strtol(compact.substr(1, 1).c_str(), nullptr, 16);
+        position = 2;
+    }
+    else if (!compact.empty() && compact[0] == 'i')
+    {
+        condition.target = IndexRegister;
+        position = 1;
+    }
+    else
+    {
+        return false;
+    }
+
+    static const struct
+    {
+        const char* token;
+        Operator op;
+    } operators[] = {
+        { "==", Operator::Equal }, { "!=", Operator::NotEqual }, { "<=", Operator::LessEqual },
+        { ">=", Operator::GreaterEqual }, { "<", Operator::Less }, { ">", Operator::Greater },
+    };
+
+    bool found = false;
+    for (const auto& candidate : operators)
+    {
+        if (compact.compare(position, std::strlen(candidate.token), candidate.token) == 0)
+        {
+            condition.op = candidate.op;
+            position += std::strlen(candidate.token);
+            found = true;
+            break;
+        }
+    }
+
+    if (!found || position >= compact.size())
+        return false;
+
+    char* end = nullptr;
+    unsigned long value = std::strtoul(compact.c_str() + position, &end, 0);
+    if (*end != 0 || value > 0xFFFF)
+        return false;
+
+    condition.value = (uint16_t)value;
+
+    return true;
+}
+
+Debugger::Debugger()
+    : m_breakpoints(AddressCount / 64, 0)
+    , m_read_watch(AddressCount / 64, 0)
+    , m_write_watch(AddressCount / 64, 0)
+{
+}
+
+void Debugger::assign(std::vector<uint64_t>& bitmap, uint16_t address, bool value)
+{
+    if (value)
+        bitmap[address / 64] |= 1ull << (address % 64);
+    else
+        bitmap[address / 64] &= ~(1ull << (address % 64));
+}
+
+void Debugger::set_breakpoint(uint16_t address)
+{
+    assign(m_breakpoints, address, true);
+    m_breakpoint_conditions.erase(address);
+}
+
+void Debugger::set_breakpoint(uint16_t address, const DebugCondition& condition)
+{
+    assign(m_breakpoints, address, true);
+    m_breakpoint_conditions[address] = condition;
+}
+
+bool Debugger::clear_breakpoint(uint16_t address)
+{
+    const bool existed = test(m_breakpoints, address);
+
+    assign(m_breakpoints, address, false);
+    m_breakpoint_conditions.erase(address);
+
+    return existed;
+}
+
+void Debugger::set_watchpoint(uint16_t address, uint32_t length, bool read, bool write)
+{
+    for (uint32_t offset = 0; offset < length && (address + offset) < AddressCount; offset++)
+    {
+        if (read)
+            assign(m_read_watch, (uint16_t)(address + offset), true);
+        if (write)
+            assign(m_write_watch, (uint16_t)(address + offset), true);
+    }
+}
+
+void Debugger::clear_watchpoint(uint16_t address, uint32_t length)
+{
+    for (uint32_t offset = 0; offset < length && (address + offset) < AddressCount; offset++)
+    {
+        assign(m_read_watch, (uint16_t)(address + offset), false);
+        assign(m_write_watch, (uint16_t)(address + offset), false);
+    }
+}
+
+void Debugger::add_condition(const DebugCondition& condition)
+{
+    WatchedCondition watched;
+    watched.condition = condition;
+    m_conditions.push_back(watched);
+}
+
+void Debugger::clear_all()
+{
+    m_breakpoints.assign(AddressCount / 64, 0);
+    m_read_watch.assign(AddressCount / 64, 0);
+    m_write_watch.assign(AddressCount / 64, 0);
+    m_breakpoint_conditions.clear();
+    m_conditions.clear();
+}
+
+std::vector<Debugger::Breakpoint> Debugger::breakpoints() const
+{
+    std::vector<Breakpoint> result;
+
+    for (uint32_t address = 0; address < AddressCount; address++)
+    {
+        if (!test(m_breakpoints, (uint16_t)address))
+            continue;
+
+        Breakpoint breakpoint;
+        breakpoint.address = (uint16_t)address;
+
+        auto condition = m_breakpoint_conditions.find((uint16_t)address);
+        if (condition != m_breakpoint_conditions.end())
+        {
+            breakpoint.conditional = true;
+            breakpoint.condition = condition->second;
+        }
+
+        result.push_back(breakpoint);
+    }
+
+    return result;
+}
+
+std::vector<Debugger::Watchpoint> Debugger::watchpoints() const
+{
+    std::vector<Watchpoint> result;
+
+    // Coalesce neighbouring addresses watched the same way into ranges
+    for (uint32_t address = 0; address < AddressCount; address++)
+    {
+        const bool read = test(m_read_watch, (uint16_t)address);
+        const bool write = test(m_write_watch, (uint16_t)address);
+        if (!read && !write)
+            continue;
+
+        if (!result.empty())
+        {
+            Watchpoint& last = result.back();
+            if (last.address + last.length == address && last.read == read && last.write == write)
+            {
+                last.length++;
+                continue;
+            }
+        }
+
+        Watchpoint watchpoint;
+        watchpoint.address = (uint16_t)address;
+        watchpoint.length = 1;
+        watchpoint.read = read;
+        watchpoint.write = write;
+        result.push_back(watchpoint);
+    }
+
+    return result;
+}
+
+std::vector<DebugCondition> Debugger::conditions() const
+{
+    std::vector<DebugCondition> result;
+    for (const auto& watched : m_conditions)
+        result.push_back(watched.condition);
+
+    return result;
+}
+
+void Debugger::resume(uint16_t pc)
+{
+    m_stop = DebugStop::None;
+    m_stepping = false;
+    m_skip_pending = true;
+    m_skip_pc = pc;
+    m_interrupt_requested = false;
+}
+
+void Debugger::step(uint16_t pc)
+{
+    resume(pc);
+    m_stepping = true;
+}
+
+void Debugger::step_over(const CHIP8Base::Registers& registers, uint16_t opcode)
+{
+    if ((opcode & 0xF000) != 0x2000)
+    {
+        step(registers.PC);
+        return;
+    }
+
+    resume(registers.PC);
+    m_step_over = true;
+    m_step_over_pc = (uint16_t)(registers.PC + 2);
+    m_step_over_depth = m_call_depth;
+}
+
+void Debugger::stop(DebugStop reason, uint16_t address, uint8_t value)
+{
+    // The first reason found during an instruction is the one reported
+    if (m_stop != DebugStop::None)
+        return;
+
+    m_stop = reason;
+    m_stop_address = address;
+    m_stop_value = value;
+    m_stepping = false;
+    m_step_over = false;
+}
+
+bool Debugger::break_before(const CHIP8Base::Registers& registers)
+{
+    m_depth_sp = registers.SP;
+
+    if (m_stop != DebugStop::None)
+        return true;
+
+    if (m_interrupt_requested.exchange(false))
+    {
+        stop(DebugStop::Interrupt, registers.PC);
+        return true;
+    }
+
+    if (m_skip_pending)
+    {
+        m_skip_pending = false;
+        if (registers.PC == m_skip_pc)
+            return false;
+    }
+
+    if (m_step_over && registers.PC == m_step_over_pc && m_call_depth == m_step_over_depth)
+    {
+        stop(DebugStop::Step, registers.PC);
+        return true;
+    }
+
+    if (test(m_breakpoints, registers.PC))
+    {
+        auto condition = m_breakpoint_conditions.find(registers.PC);
+        if (condition == m_breakpoint_conditions.end() || condition->second.evaluate(registers))
+        {
+            stop(DebugStop::Breakpoint, registers.PC);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Debugger::break_after(const CHIP8Base::Registers& registers)
+{
+    m_instructions++;
+
+    // An instruction pushes or pops at most once, so the wrapped SP difference is the call or return
+    const uint16_t sp_delta = (registers.SP - m_depth_sp) & CHIP8Base::StackMask;
+    if (sp_delta == 1)
+        m_call_depth++;
+    else if (sp_delta == CHIP8Base::StackMask)
+        m_call_depth--;
+
+    for (auto& watched : m_conditions)
+    {
+        const bool value = watched.condition.evaluate(registers);
+        if (value && !watched.last)
+            stop(DebugStop::Condition, registers.PC);
+
+        watched.last = value;
+    }
+
+    if (m_stepping)
+        stop(DebugStop::Step, registers.PC);
+
+    return m_stop != DebugStop::None;
+}
+
+void Debugger::memory_read(uint16_t address, uint8_t value)
+{
+    if (test(m_read_watch, address))
+        stop(DebugStop::ReadWatch, address, value);
+}
+
+void Debugger::memory_written(uint16_t address, uint8_t value)
+{
+    if (test(m_write_watch, address))
+        stop(DebugStop::WriteWatch, address, value);
+}
+
+int disassemble(uint16_t opcode, uint16_t next, uint8_t quirks, std::string& text)
+{
+    const int x = (opcode >> 8) & 0xF;
+    const int y = (opcode >> 4) & 0xF;
+    const int n = opcode & 0xF;
+    const int kk = opcode & 0xFF;
+    const int nnn = opcode & 0xFFF;
+
+    char buffer[32];
+    int length = 2;
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+            std::snprintf(buffer, sizeof(buffer), "CLS");
+        else if (opcode == 0x00EE)
+            std::snprintf(buffer, sizeof(buffer), "RET");
+        else if ((opcode & 0xFFF0) == 0x00C0)
+            std::snprintf(buffer, sizeof(buffer), "SCD %d", n);
+        else if ((opcode & 0xFFF0) == 0x00D0)
+            std::snprintf(buffer, sizeof(buffer), "SCU %d", n);
+        else if (opcode == 0x00FB)
+            std::snprintf(buffer, sizeof(buffer), "SCR");
+        else if (opcode == 0x00FC)
+            std::snprintf(buffer, sizeof(buffer), "SCL");
+        else if (opcode == 0x00FD)
+            std::snprintf(buffer, sizeof(buffer), "EXIT");
+        else if (opcode == 0x00FE)
+            std::snprintf(buffer, sizeof(buffer), "LOW");
+        else if (opcode == 0x00FF)
+            std::snprintf(buffer, sizeof(buffer), "HIGH");
+        else
+            std::snprintf(buffer, sizeof(buffer), "SYS 0x%03X", nnn);
+        break;
+
+    case 0x1: std::snprintf(buffer, sizeof(buffer), "JP 0x%03X", nnn); break;
+    case 0x2: std::snprintf(buffer, sizeof(buffer), "CALL 0x%03X", nnn); break;
+    case 0x3: std::snprintf(buffer, sizeof(buffer), "SE V%X, 0x%02X", x, kk); break;
+    case 0x4: std::snprintf(buffer, sizeof(buffer), "SNE V%X, 0x%02X", x, kk); break;
+
+    case 0x5:
+        if (n == 2)
+            std::snprintf(buffer, sizeof(buffer), "SAVE V%X-V%X", x, y);
+        else if (n == 3)
+            std::snprintf(buffer, sizeof(buffer), "LOAD V%X-V%X", x, y);
+        else
+            std::snprintf(buffer, sizeof(buffer), "SE V%X, V%X", x, y);
+        break;
+
+    case 0x6: std::snprintf(buffer, sizeof(buffer), "LD V%X, 0x%02X", x, kk); break;
+    case 0x7: std::snprintf(buffer, sizeof(buffer), "ADD V%X, 0x%02X", x, kk); break;
+
+    case 0x8:
+    {
+        static const char* operations[16] = { "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr };
+        if (operations[n])
+            std::snprintf(buffer, sizeof(buffer), "%s V%X, V%X", operations[n], x, y);
+        else
+            std::snprintf(buffer, sizeof(buffer), "DW 0x%04X", opcode);
+        break;
+    }
+
+    case 0x9:
+        if (n == 0)
+            std::snprintf(buffer, sizeof(buffer), "SNE V%X, V%X", x, y);
+        else
+            std::snprintf(buffer, sizeof(buffer), "DW 0x%04X", opcode);
+        break;
+
+    case 0xA: std::snprintf(buffer, sizeof(buffer), "LD I, 0x%03X", nnn); break;
+    case 0xB: std::snprintf(buffer, sizeof(buffer), "JP V%X, 0x%03X", (quirks & Quirk::JumpUsesVX) ? x : 0, nnn); break;
+    case 0xC: std::snprintf(buffer, sizeof(buffer), "RND V%X, 0x%02X", x, kk); break;
+    case 0xD: std::snprintf(buffer, sizeof(buffer), "DRW V%X, V%X, %d", x, y, n); break;
+
+    case 0xE:
+        if (kk == 0x9E)
+            std::snprintf(buffer, sizeof(buffer), "SKP V%X", x);
+        else if (kk == 0xA1)
+            std::snprintf(buffer, sizeof(buffer), "SKNP V%X", x);
+        else
+            std::snprintf(buffer, sizeof(buffer), "DW 0x%04X", opcode);
+        break;
+
+    case 0xF:
+        switch (kk)
+        {
+        case 0x00:
+            if (x == 0)
+            {
+                std::snprintf(buffer, sizeof(buffer), "LD I, 0x%04X", next);
+                length = 4;
+            }
+            else
+            {
+                std::snprintf(buffer, sizeof(buffer), "DW 0x%04X", opcode);
+            }
+            break;
+
+        case 0x01: std::snprintf(buffer, sizeof(buffer), "PLANE %d", x); break;
+        case 0x02: std::snprintf(buffer, sizeof(buffer), "AUDIO"); break;
+        case 0x07: std::snprintf(buffer, sizeof(buffer), "LD V%X, DT", x); break;
+        case 0x0A: std::snprintf(buffer, sizeof(buffer), "LD V%X, K", x); break;
+        case 0x15: std::snprintf(buffer, sizeof(buffer), "LD DT, V%X", x); break;
+        case 0x18: std::snprintf(buffer, sizeof(buffer), "LD ST, V%X", x); break;
+        case 0x1E: std::snprintf(buffer, sizeof(buffer), "ADD I, V%X", x); break;
+        case 0x29: std::snprintf(buffer, sizeof(buffer), "LD F, V%X", x); break;
+        case 0x30: std::snprintf(buffer, sizeof(buffer), "LD HF, V%X", x); break;
+        case 0x33: std::snprintf(buffer, sizeof(buffer), "LD B, V%X", x); break;
+        case 0x3A: std::snprintf(buffer, sizeof(buffer), "PITCH V%X", x); break;
+        case 0x55: std::snprintf(buffer, sizeof(buffer), "LD [I], V%X", x); break;
+        case 0x65: std::snprintf(buffer, sizeof(buffer), "LD V%X, [I]", x); break;
+        case 0x75: std::snprintf(buffer, sizeof(buffer), "LD R, V%X", x); break;
+        case 0x85: std::snprintf(buffer, sizeof(buffer), "LD V%X, R", x); break;
+        default: std::snprintf(buffer, sizeof(buffer), "DW 0x%04X", opcode); break;
+        }
+        break;
+    }
+
+    text = buffer;
+
+    return length;
+}
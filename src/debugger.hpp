@@ -0,0 +1,146 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class DebugStop
+{
+    None,
+    Breakpoint,
+    Condition,
+    ReadWatch,
+    WriteWatch,
+    Step,
+    Interrupt
+};
+
+// Compares V0-VF or I against a constant, e.g. "v3 == 5" or "i >= 0x300"
+struct DebugCondition
+{
+    enum class Operator
+    {
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual
+    };
+
+    // 0-15 select V0-VF, IndexRegister selects I
+    int target = 0;
+    Operator op = Operator::Equal;
+    uint16_t value = 0;
+
+    static inline constexpr int IndexRegister = 16;
+
+    bool evaluate(const CHIP8Base::Registers& registers) const;
+    std::string to_string() const;
+    static bool parse(const std::string& text, DebugCondition& condition);
+};
+
+// Breakpoints, watchpoints and stepping for a core instantiated with Feature::Debugger.
+// Breakpoints and watchpoints are bitmaps over the whole 64 KB address space, so the
+// hooks cost a bit test per instruction or access.
+class Debugger : public DebugHooks
+{
+public:
+    struct Breakpoint
+    {
+        uint16_t address = 0;
+        bool conditional = false;
+        DebugCondition condition;
+    };
+
+    struct Watchpoint
+    {
+        uint16_t address = 0;
+        uint32_t length = 0;
+        bool read = false;
+        bool write = false;
+    };
+
+    Debugger();
+
+    void set_breakpoint(uint16_t address);
+    void set_breakpoint(uint16_t address, const DebugCondition& condition);
+    bool clear_breakpoint(uint16_t address);
+    bool has_breakpoint(uint16_t address) const { return test(m_breakpoints, address); }
+    void set_watchpoint(uint16_t address, uint32_t length, bool read, bool write);
+    void clear_watchpoint(uint16_t address, uint32_t length);
+    // Stops once each time the condition becomes true
+    void add_condition(const DebugCondition& condition);
+    void clear_all();
+
+    std::vector<Breakpoint> breakpoints() const;
+    std::vector<Watchpoint> watchpoints() const;
+    std::vector<DebugCondition> conditions() const;
+
+    // Clears the stop and lets execution go on, a breakpoint at pc is skipped once
+    void resume(uint16_t pc);
+    void step(uint16_t pc);
+    // Steps over a 2NNN call by running until it returns at the same call depth
+    void step_over(const CHIP8Base::Registers& registers, uint16_t opcode);
+    // Safe to call from a signal handler
+    void interrupt() { m_interrupt_requested = true; }
+
+    DebugStop stop_reason() const { return m_stop; }
+    bool stopped() const { return m_stop != DebugStop::None; }
+    uint16_t stop_address() const { return m_stop_address; }
+    uint8_t stop_value() const { return m_stop_value; }
+    uint64_t instructions() const { return m_instructions; }
+
+    // Calls minus returns since the last reset. SP wraps after 16 nested calls and older
+    // return addresses get overwritten, the depth keeps counting.
+    int64_t call_depth() const { return m_call_depth; }
+    void reset_call_depth(uint16_t sp) { m_call_depth = sp; m_depth_sp = sp; }
+
+    bool break_before(const CHIP8Base::Registers& registers) override;
+    bool break_after(const CHIP8Base::Registers& registers) override;
+    void memory_read(uint16_t address, uint8_t value) override;
+    void memory_written(uint16_t address, uint8_t value) override;
+
+private:
+    struct WatchedCondition
+    {
+        DebugCondition condition;
+        bool last = false;
+    };
+
+    static inline constexpr auto AddressCount = 0x10000;
+
+    std::vector<uint64_t> m_breakpoints;
+    std::vector<uint64_t> m_read_watch;
+    std::vector<uint64_t> m_write_watch;
+    std::unordered_map<uint16_t, DebugCondition> m_breakpoint_conditions;
+    std::vector<WatchedCondition> m_conditions;
+
+    bool m_skip_pending = false;
+    uint16_t m_skip_pc = 0;
+    bool m_stepping = false;
+    bool m_step_over = false;
+    uint16_t m_step_over_pc = 0;
+    int64_t m_step_over_depth = 0;
+    int64_t m_call_depth = 0;
+    uint16_t m_depth_sp = 0;
+
+    DebugStop m_stop = DebugStop::None;
+    uint16_t m_stop_address = 0;
+    uint8_t m_stop_value = 0;
+    std::atomic<bool> m_interrupt_requested { false };
+    uint64_t m_instructions = 0;
+
+    static bool test(const std::vector<uint64_t>& bitmap, uint16_t address) { return ((bitmap[address / 64] >> (address % 64)) & 1) != 0; }
+    static void assign(std::vector<uint64_t>& bitmap, uint16_t address, bool value);
+    void stop(DebugStop reason, uint16_t address, uint8_t value = 0);
+};
+
+// Formats one instruction with Cowgod style mnemonics. next is the following word,
+// only used by the double width XO-CHIP F000 NNNN, quirks select the BNNN/BXNN form.
+// Returns the length in bytes.
+int disassemble(uint16_t opcode, uint16_t next, uint8_t quirks, std::string& text);
@@ -1,17 +1,31 @@
 #include "emulator.hpp"
-#include "utils.hpp"
+#include "mapped_file.hpp"
+#include "palette.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <thread>
+#include <time.h>
 #include <SDL.h>
 #include <SDL_syswm.h>
 
+// Host keys for the 4x4 keypad grid, RomMetadata::key_layout maps each position to a CHIP-8 key
+static const SDL_Scancode keypad_scancodes[CHIP8Base::KeyCount] = {
+    SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4,
+    SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
+    SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F,
+    SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V
+};
+
 Emulator::Emulator()
 {
 }
 
 Emulator::~Emulator()
 {
+    SDL_DestroyTexture(m_post_texture);
     SDL_DestroyTexture(m_screen_texture);
     SDL_DestroyRenderer(m_renderer);
     SDL_DestroyWindow(m_window);
@@ -44,18 +58,13 @@ bool Emulator::init()
         return false;
     }
 
-    m_screen_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, CHIP8::DisplayWidth, CHIP8::DisplayHeight);
-    if (!m_screen_texture)
-    {
-        std::string message = "SDL_CreateTexture error: " + std::string(SDL_GetError());
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), nullptr);
+    if (!create_screen_texture(CHIP8Platform<>::DisplayWidth, CHIP8Platform<>::DisplayHeight))
         return false;
-    }
 
     SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
     SDL_EventState(SDL_SYSWMEVENT, SDL_ENABLE);
 
-    if (!m_chip8.init())
+    if (!m_sound_device.init())
         return false;
 
     create_main_menu();
@@ -63,30 +72,346 @@ bool Emulator::init()
     return true;
 }
 
+bool Emulator::open_rom_pack(const std::string& path)
+{
+    if (!m_rom_pack.open(path))
+    {
+        std::string message = "Cannot open ROM pack " + path;
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+        return false;
+    }
+
+    return true;
+}
+
 void Emulator::run()
 {
-    int cycles = 0;
+    using clock = std::chrono::steady_clock;
+    constexpr auto frame_duration = std::chrono::microseconds(1000000 / FramesPerSecond);
+    auto next_frame = clock::now();
 
     while (!m_exit)
     {
-        if (m_rom_loaded && !m_paused)
-        {
-            m_chip8.execute();
-            cycles++;
-        }
-
         process_input();
-        if (m_chip8.display_updated())
+
+        if (m_wall)
+            run_wall_frame();
+        else if (m_rom_loaded && !m_paused)
+            run_frame();
+        else if (m_machine && m_machine->display_updated())
+            render();
+
+        // Drop frames instead of fast forwarding after a stall (window drag, file dialog)
+        next_frame += frame_duration;
+        if (clock::now() > next_frame + frame_duration)
+            next_frame = clock::now();
+
+        std::this_thread::sleep_until(next_frame);
+    }
+}
+
+void Emulator::run_frame()
+{
+    const uint16_t keys = read_keys();
+    m_machine->set_keys(keys);
+    m_machine->run(m_cycles_per_frame);
+    update_timers();
+
+    if (m_run_ahead_frames == 0)
+    {
+        if (m_machine->display_updated())
             render();
+        update_latency();
+        m_capture.add_frame(m_presented_display, m_machine->get_sound_timer(), keys);
+        return;
+    }
+
+    // Predictions made with the previous input may differ, so the future frame is always presented
+    m_machine->display_rendered();
+
+    m_run_ahead_state.resize(m_machine->state_size());
+    m_machine->save_state(m_run_ahead_state.data());
+
+    // Sound keeps following the real timeline, only the display is taken from the future
+    for (int frame = 0; frame < m_run_ahead_frames; frame++)
+    {
+        m_machine->run(m_cycles_per_frame);
+        m_machine->update_timers();
+    }
+
+    render();
+    update_latency();
+
+    m_machine->load_state(m_run_ahead_state.data());
+    m_capture.add_frame(m_presented_display, m_machine->get_sound_timer(), keys);
+}
+
+bool Emulator::open_capture()
+{
+    if (m_capture_path.empty())
+        return true;
+
+    if (!m_capture_writer)
+        m_capture_writer = std::make_unique<CaptureWriter>();
+
+    // Let the previous session finish writing, each ROM load records to a file of its own
+    m_capture.close();
+    m_capture_writer->flush();
+
+    std::string path = m_capture_path;
+    if (m_capture_sessions++ > 0)
+        path = capture_file_name(m_capture_path, "-" + std::to_string(m_capture_sessions));
+
+    if (m_wall)
+    {
+        if (m_wall->start_capture(*m_capture_writer, path))
+            return true;
+    }
+    else if (m_capture.open(*m_capture_writer, path, m_machine->display_width(), m_machine->display_height(), m_machine->display_planes()))
+    {
+        return true;
+    }
+
+    std::string message = "Cannot create capture file " + path;
+    SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+
+    return false;
+}
+
+void Emulator::set_run_ahead(int frames)
+{
+    m_run_ahead_frames = std::clamp(frames, 0, MaxRunAheadFrames);
+    m_latency_samples = 0;
+    m_latency_total_frames = 0.0;
+    m_latency_total_ms = 0.0;
+
+    CheckMenuRadioItem(m_run_ahead_menu, MENU_ID_RUN_AHEAD, MENU_ID_RUN_AHEAD + MaxRunAheadFrames,
+        MENU_ID_RUN_AHEAD + m_run_ahead_frames, MF_BYCOMMAND);
+}
+
+void Emulator::toggle_latency_measurement()
+{
+    m_measure_latency = !m_measure_latency;
+    m_latency_pending = false;
+    m_latency_samples = 0;
+    m_latency_total_frames = 0.0;
+    m_latency_total_ms = 0.0;
+
+    CheckMenuItem(m_emulator_menu, MENU_ID_MEASURE_LATENCY, MF_BYCOMMAND | (m_measure_latency ? MF_CHECKED : MF_UNCHECKED));
+    set_window_title(m_window_title + (m_paused ? " Paused" : " Running"));
+}
+
+void Emulator::set_filter(ScaleFilter filter)
+{
+    m_post_processor.set_filter(filter);
+
+    CheckMenuRadioItem(m_filter_menu, MENU_ID_FILTER, MENU_ID_FILTER + (int)ScaleFilter::Smooth4x,
+        MENU_ID_FILTER + (int)filter, MF_BYCOMMAND);
+
+    if (m_machine)
+        render();
+}
+
+void Emulator::toggle_crt()
+{
+    m_post_processor.set_crt(!m_post_processor.crt());
+
+    CheckMenuItem(m_emulator_menu, MENU_ID_CRT, MF_BYCOMMAND | (m_post_processor.crt() ? MF_CHECKED : MF_UNCHECKED));
+
+    if (m_machine)
+        render();
+}
+
+void Emulator::update_latency()
+{
+    if (!m_latency_pending)
+        return;
+
+    m_latency_frames++;
+
+    const int display_size = m_screen_width * m_screen_height;
+    if (std::memcmp(m_latency_reference, m_presented_display, display_size) == 0)
+        return;
+
+    // The presented display reacted to the key press, report the running average in the title
+    double elapsed_ms = (double)(SDL_GetPerformanceCounter() - m_latency_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    m_latency_pending = false;
+    m_latency_samples++;
+    m_latency_total_frames += m_latency_frames;
+    m_latency_total_ms += elapsed_ms;
+
+    char text[128];
+    std::snprintf(text, sizeof(text), " Running - latency %.2f frames / %.1f ms (run-ahead %d, %d samples)",
+        m_latency_total_frames / m_latency_samples, m_latency_total_ms / m_latency_samples, m_run_ahead_frames, m_latency_samples);
+    set_window_title(m_window_title + text);
+}
+
+bool Emulator::create_screen_texture(int width, int height)
+{
+    if (m_screen_texture && width == m_screen_width && height == m_screen_height)
+        return true;
+
+    SDL_DestroyTexture(m_screen_texture);
+    m_screen_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!m_screen_texture)
+    {
+        std::string message = "SDL_CreateTexture error: " + std::string(SDL_GetError());
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+        return false;
+    }
+
+    m_screen_width = width;
+    m_screen_height = height;
+
+    return true;
+}
+
+bool Emulator::create_post_texture(int width, int height)
+{
+    if (m_post_texture && width == m_post_width && height == m_post_height)
+        return true;
+
+    SDL_DestroyTexture(m_post_texture);
+    m_post_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!m_post_texture)
+    {
+        // Falls back to the unfiltered screen texture instead of failing every frame
+        m_post_processor.set_filter(ScaleFilter::None);
+        m_post_processor.set_crt(false);
+        CheckMenuRadioItem(m_filter_menu, MENU_ID_FILTER, MENU_ID_FILTER + (int)ScaleFilter::Smooth4x, MENU_ID_FILTER, MF_BYCOMMAND);
+        CheckMenuItem(m_emulator_menu, MENU_ID_CRT, MF_BYCOMMAND | MF_UNCHECKED);
+
+        std::string message = "SDL_CreateTexture error: " + std::string(SDL_GetError());
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+        return false;
+    }
+
+    m_post_width = width;
+    m_post_height = height;
+
+    return true;
+}
+
+void Emulator::update_timers()
+{
+    m_machine->update_timers();
+    update_sound(*m_machine);
+}
+
+void Emulator::update_sound(const Machine& machine)
+{
+    if (machine.sound_active())
+    {
+        m_sound_device.set_pattern(machine.get_audio_pattern(), machine.get_audio_pitch());
+        m_sound_device.play();
+    }
+    else
+    {
+        m_sound_device.stop();
+    }
+}
+
+void Emulator::run_wall_frame()
+{
+    if (!m_paused)
+    {
+        m_wall->run_frame(read_keys());
+
+        // Only the focused instance is heard
+        if (m_wall->focus() >= 0)
+            update_sound(m_wall->machine(m_wall->focus()));
+        else
+            m_sound_device.stop();
+    }
+
+    m_wall->render(m_renderer);
+
+    m_wall_frames++;
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (now - m_wall_fps_start >= SDL_GetPerformanceFrequency())
+    {
+        update_wall_title();
+        m_wall_frames = 0;
+        m_wall_fps_start = now;
+    }
+}
 
-        if (cycles == TimersCycleDivision)
+void Emulator::update_wall_title()
+{
+    double seconds = (double)(SDL_GetPerformanceCounter() - m_wall_fps_start) / (double)SDL_GetPerformanceFrequency();
+    int fps = (seconds > 0.0) ? (int)(m_wall_frames / seconds + 0.5) : 0;
+
+    std::string title = m_window_title + " " + std::to_string(fps) + " fps";
+    if (m_wall->focus() >= 0)
+        title += " - #" + std::to_string(m_wall->focus()) + " " + m_wall->name(m_wall->focus());
+    if (m_paused)
+        title += " Paused";
+
+    set_window_title(title);
+}
+
+bool Emulator::open_wall(int count, const std::vector<std::string>& rom_paths)
+{
+    if (count <= 0 || (rom_paths.empty() && m_rom_pack.count() == 0))
+    {
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), "The wall view needs ROM files or a ROM pack", m_window);
+        return false;
+    }
+
+    // Hashing cores let the wall skip redraws that leave the display unchanged
+    auto wall = std::make_unique<WallView>();
+    for (int index = 0; index < count; index++)
+    {
+        std::unique_ptr<Machine> machine;
+        RomMetadata metadata;
+        std::string name;
+
+        if (!rom_paths.empty())
+        {
+            name = rom_paths[index % rom_paths.size()];
+
+            MappedFile rom_file;
+            if (!rom_file.open(name))
+            {
+                std::string message = "Cannot open ROM file " + name;
+                SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+                return false;
+            }
+
+            if (!create_machine_for_rom(rom_file.data(), rom_file.size(), name, machine, metadata, Feature::StateHash))
+                return false;
+        }
+        else
         {
-            m_chip8.update_timers();
-            cycles = 0;
+            const RomPackEntry& entry = m_rom_pack.entry(index % m_rom_pack.count());
+            name = m_rom_pack.rom_name(entry);
+
+            if (!create_machine_for_rom(m_rom_pack.rom_data(entry), entry.data_size, name, machine, metadata, Feature::StateHash))
+                return false;
         }
 
-        std::this_thread::sleep_for(std::chrono::microseconds(1));
+        machine->seed((uint32_t)time(NULL) + index);
+
+        wall->add_instance(std::move(machine), metadata, name, instructions_per_frame(metadata));
     }
+
+    if (!wall->init(m_renderer))
+    {
+        std::string message = "Cannot create the wall texture atlas: " + std::string(SDL_GetError());
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+        return false;
+    }
+
+    m_wall = std::move(wall);
+    m_machine.reset();
+    open_capture();
+    m_rom_loaded = false;
+    m_wall_frames = 0;
+    m_wall_fps_start = SDL_GetPerformanceCounter();
+    m_window_title = "CHIP-8 Wall [" + std::to_string(count) + " instances]";
+    set_window_title(m_window_title);
+
+    return true;
 }
 
 void Emulator::create_main_menu()
@@ -94,6 +419,8 @@ void Emulator::create_main_menu()
     m_menu_bar = CreateMenu();
     m_file_menu = CreateMenu();
     m_emulator_menu = CreateMenu();
+    m_run_ahead_menu = CreateMenu();
+    m_filter_menu = CreateMenu();
 
     AppendMenu(m_menu_bar, MF_POPUP, (UINT_PTR)m_file_menu, "File");
     AppendMenu(m_menu_bar, MF_POPUP, (UINT_PTR)m_emulator_menu, "Emulator");
@@ -105,6 +432,25 @@ void Emulator::create_main_menu()
     AppendMenu(m_emulator_menu, MF_STRING, MENU_ID_PAUSE_RESUME, "Pause\tCtr+P");
     AppendMenu(m_emulator_menu, MF_SEPARATOR, 0, "");
     AppendMenu(m_emulator_menu, MF_STRING, MENU_ID_RESET, "Reset\tCtr+R");
+    AppendMenu(m_emulator_menu, MF_SEPARATOR, 0, "");
+    AppendMenu(m_emulator_menu, MF_POPUP, (UINT_PTR)m_run_ahead_menu, "Run-ahead");
+    AppendMenu(m_emulator_menu, MF_STRING, MENU_ID_MEASURE_LATENCY, "Measure input latency\tCtr+L");
+
+    AppendMenu(m_run_ahead_menu, MF_STRING, MENU_ID_RUN_AHEAD, "Off");
+    AppendMenu(m_run_ahead_menu, MF_STRING, MENU_ID_RUN_AHEAD + 1, "1 frame");
+    AppendMenu(m_run_ahead_menu, MF_STRING, MENU_ID_RUN_AHEAD + 2, "2 frames");
+    AppendMenu(m_run_ahead_menu, MF_STRING, MENU_ID_RUN_AHEAD + 3, "3 frames");
+    CheckMenuRadioItem(m_run_ahead_menu, MENU_ID_RUN_AHEAD, MENU_ID_RUN_AHEAD + MaxRunAheadFrames, MENU_ID_RUN_AHEAD, MF_BYCOMMAND);
+
+    AppendMenu(m_emulator_menu, MF_SEPARATOR, 0, "");
+    AppendMenu(m_emulator_menu, MF_POPUP, (UINT_PTR)m_filter_menu, "Filter");
+    AppendMenu(m_emulator_menu, MF_STRING, MENU_ID_CRT, "CRT scanlines");
+
+    AppendMenu(m_filter_menu, MF_STRING, MENU_ID_FILTER + (int)ScaleFilter::None, "Off");
+    AppendMenu(m_filter_menu, MF_STRING, MENU_ID_FILTER + (int)ScaleFilter::Scale2x, scale_filter_name(ScaleFilter::Scale2x));
+    AppendMenu(m_filter_menu, MF_STRING, MENU_ID_FILTER + (int)ScaleFilter::Scale4x, scale_filter_name(ScaleFilter::Scale4x));
+    AppendMenu(m_filter_menu, MF_STRING, MENU_ID_FILTER + (int)ScaleFilter::Smooth4x, scale_filter_name(ScaleFilter::Smooth4x));
+    CheckMenuRadioItem(m_filter_menu, MENU_ID_FILTER, MENU_ID_FILTER + (int)ScaleFilter::Smooth4x, MENU_ID_FILTER, MF_BYCOMMAND);
 
     HWND window_handle = get_window_handle(m_window);
     SetMenu(window_handle, m_menu_bar);
@@ -132,6 +478,20 @@ void Emulator::process_input()
 
                 if (LOWORD(event.syswm.msg->msg.win.wParam) == MENU_ID_RESET)
                     reset();
+
+                if (LOWORD(event.syswm.msg->msg.win.wParam) == MENU_ID_MEASURE_LATENCY)
+                    toggle_latency_measurement();
+
+                if (LOWORD(event.syswm.msg->msg.win.wParam) >= MENU_ID_RUN_AHEAD &&
+                    LOWORD(event.syswm.msg->msg.win.wParam) <= MENU_ID_RUN_AHEAD + MaxRunAheadFrames)
+                    set_run_ahead(LOWORD(event.syswm.msg->msg.win.wParam) - MENU_ID_RUN_AHEAD);
+
+                if (LOWORD(event.syswm.msg->msg.win.wParam) == MENU_ID_CRT)
+                    toggle_crt();
+
+                if (LOWORD(event.syswm.msg->msg.win.wParam) >= MENU_ID_FILTER &&
+                    LOWORD(event.syswm.msg->msg.win.wParam) <= MENU_ID_FILTER + (int)ScaleFilter::Smooth4x)
+                    set_filter((ScaleFilter)(LOWORD(event.syswm.msg->msg.win.wParam) - MENU_ID_FILTER));
             }
             break;
 
@@ -160,6 +520,52 @@ void Emulator::process_input()
             {
                 reset();
             }
+
+            if (event.key.keysym.sym == SDLK_ESCAPE && m_wall)
+            {
+                m_wall->set_focus(-1);
+                update_wall_title();
+            }
+
+            if (event.key.keysym.sym == SDLK_l &&
+                event.key.keysym.mod & KMOD_CTRL &&
+                event.key.repeat == 0)
+            {
+                toggle_latency_measurement();
+            }
+
+            if (m_measure_latency && !m_paused && m_rom_loaded &&
+                event.key.repeat == 0 &&
+                std::find(std::begin(keypad_scancodes), std::end(keypad_scancodes), event.key.keysym.scancode) != std::end(keypad_scancodes))
+            {
+                std::memcpy(m_latency_reference, m_presented_display, sizeof(m_latency_reference));
+                m_latency_start = SDL_GetPerformanceCounter();
+                m_latency_frames = 0;
+                m_latency_pending = true;
+            }
+            break;
+
+        case SDL_MOUSEBUTTONDOWN:
+            if (m_wall && event.button.button == SDL_BUTTON_LEFT && m_wall->focus() < 0)
+            {
+                int width = 0;
+                int height = 0;
+                SDL_GetWindowSize(m_window, &width, &height);
+
+                int index = m_wall->instance_at(event.button.x, event.button.y, width, height);
+                if (index >= 0)
+                {
+                    m_wall->set_focus(index);
+                    set_key_layout(m_wall->metadata(index));
+                    update_wall_title();
+                }
+            }
+
+            if (m_wall && event.button.button == SDL_BUTTON_RIGHT)
+            {
+                m_wall->set_focus(-1);
+                update_wall_title();
+            }
             break;
 
         case SDL_WINDOWEVENT:
@@ -167,6 +573,10 @@ void Emulator::process_input()
             {
                 m_window_width = event.window.data1;
                 m_window_height = event.window.data2;
+
+                // The CRT stage renders at the window size
+                if (m_post_processor.crt() && m_machine)
+                    render();
             }
             break;
 
@@ -176,12 +586,26 @@ void Emulator::process_input()
     }
 }
 
+uint16_t Emulator::read_keys()
+{
+    const uint8_t* state = SDL_GetKeyboardState(nullptr);
+    uint16_t keys = 0;
+
+    for (int index = 0; index < CHIP8Base::KeyCount; index++)
+    {
+        if (state[keypad_scancodes[index]])
+            keys |= 1 << m_key_layout[index];
+    }
+
+    return keys;
+}
+
 void Emulator::update_screen_buffer()
 {
-    for (int index = 0; index < (CHIP8::DisplayWidth * CHIP8::DisplayHeight); index++)
+    for (int index = 0; index < (m_screen_width * m_screen_height); index++)
     {
-        uint8_t pixel = m_chip8.get_display()[index];
-        m_screen_buffer[index] = (0x00FFFF00 * pixel) | 0xFF000000;
+        uint8_t pixel = m_machine->get_display()[index];
+        m_screen_buffer[index] = DisplayPalette[pixel & 3];
     }
 }
 
@@ -189,10 +613,31 @@ void Emulator::render()
 {
     SDL_RenderClear(m_renderer);
     update_screen_buffer();
-    SDL_UpdateTexture(m_screen_texture, nullptr, m_screen_buffer, CHIP8::DisplayWidth * sizeof(uint32_t));
-    SDL_RenderCopy(m_renderer, m_screen_texture, nullptr, nullptr);
+    std::memcpy(m_presented_display, m_machine->get_display(), m_screen_width * m_screen_height);
+
+    SDL_Texture* texture = m_screen_texture;
+    const uint32_t* pixels = m_screen_buffer;
+    int width = m_screen_width;
+
+    if (m_post_processor.enabled())
+    {
+        int output_width = 0;
+        int output_height = 0;
+        SDL_GetRendererOutputSize(m_renderer, &output_width, &output_height);
+
+        const uint32_t* processed = m_post_processor.process(m_screen_buffer, m_screen_width, m_screen_height, output_width, output_height);
+        if (create_post_texture(m_post_processor.output_width(), m_post_processor.output_height()))
+        {
+            texture = m_post_texture;
+            pixels = processed;
+            width = m_post_processor.output_width();
+        }
+    }
+
+    SDL_UpdateTexture(texture, nullptr, pixels, width * sizeof(uint32_t));
+    SDL_RenderCopy(m_renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(m_renderer);
-    m_chip8.display_rendered();
+    m_machine->display_rendered();
 }
 
 void Emulator::open_rom_file()
@@ -201,43 +646,70 @@ void Emulator::open_rom_file()
     if (path.empty())
         return;
 
-    std::ifstream rom_file(path, std::ifstream::binary);
-    if (!rom_file.is_open())
+    load_rom(path);
+}
+
+bool Emulator::load_rom(const std::string& path)
+{
+    MappedFile rom_file;
+    if (!rom_file.open(path))
     {
         std::string message = "Cannot open ROM file " + path;
         SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
-        return;
+        return false;
     }
 
-    uint32_t buffer_size = get_file_size(path);
-    char* buffer = static_cast<char*>(malloc(sizeof(char) * buffer_size));
-    if (!rom_file.read(buffer, buffer_size))
-    {
-        std::string message = "Cannot read ROM file " + path;
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
-        return;
-    }
+    std::unique_ptr<Machine> machine;
+    RomMetadata metadata;
+    if (!create_machine_for_rom(rom_file.data(), rom_file.size(), path, machine, metadata))
+        return false;
 
-    if (!m_chip8.load_rom_in_memory(buffer, buffer_size))
-    {
-        std::string message = "Cannot load ROM file " + path + " into memory, size is " + std::to_string(buffer_size);
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
-        return;
-    }
+    if (!create_screen_texture(machine->display_width(), machine->display_height()))
+        return false;
 
+    m_machine = std::move(machine);
+    m_machine->seed((uint32_t)time(NULL));
+
+    m_cycles_per_frame = instructions_per_frame(metadata);
+    set_key_layout(metadata);
+    m_wall.reset();
+    open_capture();
 
     if (m_paused)
         toggle_pause();
 
-    m_window_title = "CHIP-8 [" + path + "]";
+    m_window_title = std::string(platform_name(metadata.platform)) + " [" + path + "]";
     set_window_title(m_window_title + " Running");
     m_rom_loaded = true;
-    free(buffer);
+
+    return true;
+}
+
+bool Emulator::create_machine_for_rom(const uint8_t* rom, size_t size, const std::string& path, std::unique_ptr<Machine>& machine, RomMetadata& metadata, uint32_t features)
+{
+    // Known ROMs get their platform, quirks, speed and keys from the ROM pack
+    metadata = resolve_rom_metadata(path, rom, size, m_rom_pack);
+
+    machine = create_machine(metadata.platform, metadata.quirks, features);
+    if (size > UINT32_MAX || !machine->load_rom_in_memory(reinterpret_cast<const char*>(rom), (uint32_t)size))
+    {
+        std::string message = "Cannot load ROM file " + path + " into memory, size is " + std::to_string(size);
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, m_window_title.c_str(), message.c_str(), m_window);
+        return false;
+    }
+
+    return true;
+}
+
+void Emulator::set_key_layout(const RomMetadata& metadata)
+{
+    for (int index = 0; index < CHIP8Base::KeyCount; index++)
+        m_key_layout[index] = (metadata.key_layout[index / 2] >> ((index & 1) ? 0 : 4)) & 0xF;
 }
 
 void Emulator::toggle_pause()
 {
-    if (!m_rom_loaded)
+    if (!m_rom_loaded && !m_wall)
         return;
 
     m_paused = !m_paused;
@@ -256,13 +728,19 @@ void Emulator::toggle_pause()
 
 void Emulator::reset()
 {
+    if (m_wall)
+    {
+        m_wall->reset();
+        return;
+    }
+
     if (!m_rom_loaded)
         return;
 
     if (m_paused)
         toggle_pause();
 
-    m_chip8.reset();
+    m_machine->reset();
 }
 
 void Emulator::set_window_title(const std::string& title)
@@ -1,9 +1,17 @@
 #pragma once
 
+#include "capture.hpp"
 #include "chip8.hpp"
+#include "machine.hpp"
+#include "post_process.hpp"
+#include "rom_pack.hpp"
+#include "sound.hpp"
+#include "wall_view.hpp"
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include <Windows.h>
 
 struct SDL_Window;
@@ -17,6 +25,14 @@ public:
     ~Emulator();
 
     bool init();
+    bool open_rom_pack(const std::string& path);
+    bool load_rom(const std::string& path);
+    bool open_wall(int count, const std::vector<std::string>& rom_paths);
+    void set_capture_path(const std::string& path) { m_capture_path = path; }
+    void set_run_ahead(int frames);
+    void toggle_latency_measurement();
+    void set_filter(ScaleFilter filter);
+    void toggle_crt();
     void run();
 
 private:
@@ -30,23 +46,80 @@ private:
     bool m_exit = false;
     bool m_rom_loaded = false;
     bool m_paused = false;
-    uint32_t m_screen_buffer[CHIP8::DisplayWidth * CHIP8::DisplayHeight] = { 0 };
+    int m_screen_width = 0;
+    int m_screen_height = 0;
+    uint32_t m_screen_buffer[MaxDisplayWidth * MaxDisplayHeight] = { 0 };
 
-    CHIP8 m_chip8;
+    // Post-processed frames go through their own texture, sized to the filter output
+    PostProcessor m_post_processor;
+    SDL_Texture* m_post_texture = nullptr;
+    int m_post_width = 0;
+    int m_post_height = 0;
 
-    static inline constexpr auto TimersCycleDivision = 9;
+    std::unique_ptr<Machine> m_machine;
+    Sound m_sound_device;
+    RomPack m_rom_pack;
+    // Declared before everything that owns encoders, they flush into it on destruction
+    std::unique_ptr<CaptureWriter> m_capture_writer;
+    std::unique_ptr<WallView> m_wall;
+    int m_wall_frames = 0;
+    uint64_t m_wall_fps_start = 0;
+    int m_cycles_per_frame = DefaultInstructionsPerSecond / FramesPerSecond;
+    uint8_t m_key_layout[CHIP8Base::KeyCount] = { 0 };
+
+    // Run-ahead: the presented frame is emulated N frames ahead with the current input, then rolled back
+    int m_run_ahead_frames = 0;
+    std::vector<uint8_t> m_run_ahead_state;
+
+    // Latency measurement: presented frames from a keypad press to the next visible display change
+    bool m_measure_latency = false;
+    bool m_latency_pending = false;
+    int m_latency_frames = 0;
+    uint64_t m_latency_start = 0;
+    int m_latency_samples = 0;
+    double m_latency_total_frames = 0.0;
+    double m_latency_total_ms = 0.0;
+    uint8_t m_presented_display[MaxDisplayWidth * MaxDisplayHeight] = { 0 };
+    uint8_t m_latency_reference[MaxDisplayWidth * MaxDisplayHeight] = { 0 };
+
+    // Capture of every presented frame, see capture.hpp
+    std::string m_capture_path;
+    CaptureEncoder m_capture;
+    int m_capture_sessions = 0;
+
+    static inline constexpr auto MaxRunAheadFrames = 3;
 
     static inline constexpr auto MENU_ID_LOAD_ROM = 1;
     static inline constexpr auto MENU_ID_EXIT = 2;
     static inline constexpr auto MENU_ID_PAUSE_RESUME = 3;
     static inline constexpr auto MENU_ID_RESET = 4;
+    static inline constexpr auto MENU_ID_MEASURE_LATENCY = 5;
+    static inline constexpr auto MENU_ID_CRT = 6;
+    // MENU_ID_RUN_AHEAD + N selects N run-ahead frames
+    static inline constexpr auto MENU_ID_RUN_AHEAD = 10;
+    // MENU_ID_FILTER + ScaleFilter selects the filter
+    static inline constexpr auto MENU_ID_FILTER = 20;
 
     HMENU m_menu_bar;
     HMENU m_file_menu;
     HMENU m_emulator_menu;
+    HMENU m_run_ahead_menu;
+    HMENU m_filter_menu;
 
     void create_main_menu();
+    bool create_screen_texture(int width, int height);
+    bool create_post_texture(int width, int height);
+    void update_timers();
+    void update_sound(const Machine& machine);
+    void set_key_layout(const RomMetadata& metadata);
+    bool create_machine_for_rom(const uint8_t* rom, size_t size, const std::string& path, std::unique_ptr<Machine>& machine, RomMetadata& metadata, uint32_t features = 0);
+    bool open_capture();
+    void run_frame();
+    void run_wall_frame();
+    void update_wall_title();
+    void update_latency();
     void process_input();
+    uint16_t read_keys();
     void update_screen_buffer();
     void render();
 
@@ -0,0 +1,161 @@
+#include "image_file.hpp"
+#include "palette.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+
+static void write_u32_be(std::vector<uint8_t>& output, uint32_t value)
+{
+    output.push_back((uint8_t)(value >> 24));
+    output.push_back((uint8_t)(value >> 16));
+    output.push_back((uint8_t)(value >> 8));
+    output.push_back((uint8_t)value);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> result {};
+        for (uint32_t index = 0; index < 256; index++)
+        {
+            uint32_t value = index;
+            for (int bit = 0; bit < 8; bit++)
+                value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+            result[index] = value;
+        }
+        return result;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t index = 0; index < size; index++)
+        crc = table[(crc ^ data[index]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void write_png_chunk(std::vector<uint8_t>& output, const char* type, const std::vector<uint8_t>& data)
+{
+    write_u32_be(output, (uint32_t)data.size());
+
+    const size_t type_offset = output.size();
+    output.insert(output.end(), type, type + 4);
+    output.insert(output.end(), data.begin(), data.end());
+
+    write_u32_be(output, crc32(output.data() + type_offset, output.size() - type_offset));
+}
+
+static bool write_file(const std::string& path, const void* data, size_t size)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    const bool written = std::fwrite(data, 1, size, file) == size;
+
+    return (std::fclose(file) == 0) && written;
+}
+
+bool write_pbm(const std::string& path, const uint8_t* display, int width, int height, int scale)
+{
+    const int image_width = width * scale;
+    const int image_height = height * scale;
+    const int row_bytes = (image_width + 7) / 8;
+
+    char header[32];
+    const int header_size = std::snprintf(header, sizeof(header), "P4\n%d %d\n", image_width, image_height);
+
+    std::vector<uint8_t> output(header, header + header_size);
+    output.resize(output.size() + (size_t)row_bytes * image_height, 0);
+    uint8_t* pixels = output.data() + header_size;
+
+    for (int y = 0; y < image_height; y++)
+    {
+        const uint8_t* source = display + ((y / scale) * width);
+        for (int x = 0; x < image_width; x++)
+        {
+            if (source[x / scale] != 0)
+                pixels[(y * row_bytes) + (x / 8)] |= (uint8_t)(0x80 >> (x % 8));
+        }
+    }
+
+    return write_file(path, output.data(), output.size());
+}
+
+bool write_png(const std::string& path, const uint8_t* display, int width, int height, int scale)
+{
+    const uint32_t image_width = (uint32_t)(width * scale);
+    const uint32_t image_height = (uint32_t)(height * scale);
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    std::vector<uint8_t> output(signature, signature + sizeof(signature));
+    std::vector<uint8_t> chunk;
+
+    // 8 bit indexed color, the display values index the palette directly
+    write_u32_be(chunk, image_width);
+    write_u32_be(chunk, image_height);
+    chunk.insert(chunk.end(), { 8, 3, 0, 0, 0 });
+    write_png_chunk(output, "IHDR", chunk);
+
+    chunk.clear();
+    for (uint32_t color : DisplayPalette)
+        chunk.insert(chunk.end(), { (uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t)color });
+    write_png_chunk(output, "PLTE", chunk);
+
+    // Rows with filter type 0, stored in uncompressed deflate blocks
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)(image_width + 1) * image_height);
+    for (uint32_t y = 0; y < image_height; y++)
+    {
+        const uint8_t* source = display + ((y / scale) * width);
+        raw.push_back(0);
+        for (uint32_t x = 0; x < image_width; x++)
+            raw.push_back(source[x / scale] & 3);
+    }
+
+    chunk.clear();
+    chunk.insert(chunk.end(), { 0x78, 0x01 });
+    size_t offset = 0;
+    bool last = false;
+    while (!last)
+    {
+        const size_t size = std::min<size_t>(0xFFFF, raw.size() - offset);
+        last = offset + size >= raw.size();
+
+        chunk.push_back(last ? 1 : 0);
+        chunk.insert(chunk.end(), { (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)~size, (uint8_t)(~size >> 8) });
+        chunk.insert(chunk.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    }
+
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (uint8_t value : raw)
+    {
+        adler_a = (adler_a + value) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    write_u32_be(chunk, (adler_b << 16) | adler_a);
+    write_png_chunk(output, "IDAT", chunk);
+
+    chunk.clear();
+    write_png_chunk(output, "IEND", chunk);
+
+    return write_file(path, output.data(), output.size());
+}
+
+void append_rgb(const uint8_t* display, int width, int height, int scale, std::vector<uint8_t>& output)
+{
+    const int image_width = width * scale;
+    const int image_height = height * scale;
+
+    for (int y = 0; y < image_height; y++)
+    {
+        const uint8_t* source = display + ((y / scale) * width);
+        for (int x = 0; x < image_width; x++)
+        {
+            const uint32_t color = DisplayPalette[source[x / scale] & 3];
+            output.insert(output.end(), { (uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t)color });
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes displays as image files, pixels are DisplayPalette indices.
+// PBM is black and white (any lit plane is black), PNG keeps the palette colors.
+bool write_pbm(const std::string& path, const uint8_t* display, int width, int height, int scale = 1);
+bool write_png(const std::string& path, const uint8_t* display, int width, int height, int scale = 1);
+
+// Appends the display as packed 24 bit RGB, the layout of raw rgb24 video frames
+void append_rgb(const uint8_t* display, int width, int height, int scale, std::vector<uint8_t>& output);
@@ -0,0 +1,66 @@
+#include "machine.hpp"
+#include "chip8.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+template <typename Platform, uint32_t Features>
+class MachineCore : public Machine
+{
+public:
+    static_assert(std::is_trivially_copyable_v<CHIP8<Platform, Features>>, "Snapshots copy the core as raw bytes");
+
+    void reset() override { m_core.reset(); }
+    void execute() override { m_core.execute(); }
+    void run(int cycles) override { m_core.run(cycles); }
+    void update_timers() override { m_core.update_timers(); }
+    bool load_rom_in_memory(const char* rom, uint32_t size) override { return m_core.load_rom_in_memory(rom, size); }
+    void set_keys(uint16_t keys) override { m_core.set_keys(keys); }
+    void seed(uint32_t value) override { m_core.seed(value); }
+
+    size_t state_size() const override { return sizeof(m_core); }
+    void save_state(uint8_t* buffer) const override { std::memcpy(buffer, &m_core, sizeof(m_core)); }
+    void load_state(const uint8_t* buffer) override { std::memcpy(&m_core, buffer, sizeof(m_core)); }
+
+    uint64_t state_hash() const override { return m_core.state_hash(); }
+    uint64_t display_hash() const override { return m_core.display_hash(); }
+
+    bool display_updated() const override { return m_core.display_updated(); }
+    void display_rendered() override { m_core.display_rendered(); }
+    const uint8_t* get_display() const override { return m_core.get_display(); }
+    const uint8_t* get_memory() const override { return m_core.get_memory(); }
+    const CHIP8Base::Registers& get_registers() const override { return m_core.get_registers(); }
+    uint8_t get_delay_timer() const override { return m_core.get_delay_timer(); }
+    uint8_t get_sound_timer() const override { return m_core.get_sound_timer(); }
+    bool sound_active() const override { return m_core.sound_active(); }
+    bool halted() const override { return m_core.halted(); }
+    const uint8_t* get_audio_pattern() const override { return m_core.get_audio_pattern(); }
+    uint8_t get_audio_pitch() const override { return m_core.get_audio_pitch(); }
+
+    PlatformType platform() const override { return Platform::Type; }
+    uint8_t quirks() const override { return Platform::Flags; }
+    int display_width() const override { return Platform::DisplayWidth; }
+    int display_height() const override { return Platform::DisplayHeight; }
+    int display_planes() const override { return Platform::Planes; }
+    uint32_t memory_size() const override { return Platform::MemorySize; }
+
+private:
+    CHIP8<Platform, Features> m_core;
+};
+
+template <uint32_t Features>
+static std::unique_ptr<Machine> create_machine_with_features(PlatformType type, uint8_t quirks)
+{
+    return dispatch_platform(type, quirks, [](auto platform) -> std::unique_ptr<Machine> {
+        using Platform = typename decltype(platform)::type;
+        return std::make_unique<MachineCore<Platform, Features>>();
+    });
+}
+
+std::unique_ptr<Machine> create_machine(PlatformType type, uint8_t quirks, uint32_t features)
+{
+    if ((features & Feature::StateHash) != 0)
+        return create_machine_with_features<Feature::StateHash>(type, quirks);
+
+    return create_machine_with_features<0>(type, quirks);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "platform.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Type erased view of a CHIP8 core so the frontend can switch between
+// platform variants per ROM. The hot loop lives inside run() so the
+// virtual dispatch is paid once per batch of instructions.
+class Machine
+{
+public:
+    virtual ~Machine() = default;
+
+    virtual void reset() = 0;
+    virtual void execute() = 0;
+    virtual void run(int cycles) = 0;
+    virtual void update_timers() = 0;
+    virtual bool load_rom_in_memory(const char* rom, uint32_t size) = 0;
+    virtual void set_keys(uint16_t keys) = 0;
+    virtual void seed(uint32_t value) = 0;
+
+    // Snapshots are a raw copy of the core, only valid for the same Machine instance type
+    virtual size_t state_size() const = 0;
+    virtual void save_state(uint8_t* buffer) const = 0;
+    virtual void load_state(const uint8_t* buffer) = 0;
+
+    virtual uint64_t state_hash() const = 0;
+    virtual uint64_t display_hash() const = 0;
+
+    virtual bool display_updated() const = 0;
+    virtual void display_rendered() = 0;
+    virtual const uint8_t* get_display() const = 0;
+    virtual const uint8_t* get_memory() const = 0;
+    virtual const CHIP8Base::Registers& get_registers() const = 0;
+    virtual uint8_t get_delay_timer() const = 0;
+    virtual uint8_t get_sound_timer() const = 0;
+    virtual bool sound_active() const = 0;
+    virtual bool halted() const = 0;
+    virtual const uint8_t* get_audio_pattern() const = 0;
+    virtual uint8_t get_audio_pitch() const = 0;
+
+    virtual PlatformType platform() const = 0;
+    virtual uint8_t quirks() const = 0;
+    virtual int display_width() const = 0;
+    virtual int display_height() const = 0;
+    virtual int display_planes() const = 0;
+    virtual uint32_t memory_size() const = 0;
+};
+
+// Feature::StateHash is the only core feature selectable here, others are for dedicated instantiations
+std::unique_ptr<Machine> create_machine(PlatformType type, uint8_t quirks, uint32_t features = 0);
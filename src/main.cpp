@@ -1,11 +1,58 @@
 #include "emulator.hpp"
+#include <cstdlib>
+#include <string>
+#include <vector>
 #include <Windows.h>
 
+static ScaleFilter parse_filter(const std::string& name)
+{
+    if (name == "scale2x")
+        return ScaleFilter::Scale2x;
+    if (name == "scale4x")
+        return ScaleFilter::Scale4x;
+    if (name == "xbr")
+        return ScaleFilter::Smooth4x;
+
+    return ScaleFilter::None;
+}
+
 int application_main(int argc, char* argv[])
 {
     Emulator chip8;
     if (!chip8.init())
         return -1;
+
+    // chip8 [--pack <rom pack>] [--run-ahead <frames>] [--measure-latency] [--wall <instances>] [--capture <file>]
+    //       [--filter scale2x|scale4x|xbr] [--crt] [rom...]
+    std::vector<std::string> roms;
+    int wall_instances = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        if (argument == "--pack" && index + 1 < argc)
+            chip8.open_rom_pack(argv[++index]);
+        else if (argument == "--run-ahead" && index + 1 < argc)
+            chip8.set_run_ahead(std::atoi(argv[++index]));
+        else if (argument == "--measure-latency")
+            chip8.toggle_latency_measurement();
+        else if (argument == "--capture" && index + 1 < argc)
+            chip8.set_capture_path(argv[++index]);
+        else if (argument == "--filter" && index + 1 < argc)
+            chip8.set_filter(parse_filter(argv[++index]));
+        else if (argument == "--crt")
+            chip8.toggle_crt();
+        else if (argument == "--wall" && index + 1 < argc)
+            wall_instances = std::atoi(argv[++index]);
+        else
+            roms.push_back(argument);
+    }
+
+    if (wall_instances > 0)
+        chip8.open_wall(wall_instances, roms);
+    else if (!roms.empty())
+        chip8.load_rom(roms.back());
+
     chip8.run();
 
     return 0;
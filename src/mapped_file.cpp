@@ -0,0 +1,132 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size {};
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_size = (size_t)file_size.QuadPart;
+    m_open = true;
+
+    // Empty files cannot be mapped, they are exposed as a valid zero sized view
+    if (m_size == 0)
+        return true;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+    {
+        close();
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+
+    if (m_mapping)
+        CloseHandle(m_mapping);
+
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat info {};
+    if (fstat(file, &info) != 0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    m_file = file;
+    m_size = (size_t)info.st_size;
+    m_open = true;
+
+    // Empty files cannot be mapped, they are exposed as a valid zero sized view
+    if (m_size == 0)
+        return true;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+    if (data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(data);
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+
+    if (m_file >= 0)
+        ::close(m_file);
+
+    m_data = nullptr;
+    m_file = -1;
+    m_size = 0;
+    m_open = false;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// ARGB colors indexed by display pixel value. Values are XO-CHIP bitplane masks,
+// plain CHIP-8 and SUPER-CHIP only use 0 and 1.
+static inline constexpr uint32_t DisplayPalette[4] = { 0xFF000000, 0xFFFFFF00, 0xFFFF5500, 0xFF555555 };
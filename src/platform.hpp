@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+enum class PlatformType : uint8_t
+{
+    CHIP8,
+    SuperChip,
+    XOChip
+};
+
+namespace Quirk
+{
+    // 8XY6/8XYE shift VX in place instead of shifting VY into VX
+    static inline constexpr uint8_t ShiftUsesVX = 1 << 0;
+    // FX55/FX65 leave I unchanged instead of incrementing it
+    static inline constexpr uint8_t LoadStoreKeepsI = 1 << 1;
+    // BXNN jumps to XNN + VX instead of NNN + V0
+    static inline constexpr uint8_t JumpUsesVX = 1 << 2;
+    // Sprites wrap around the screen edges instead of being clipped
+    static inline constexpr uint8_t WrapSprites = 1 << 3;
+
+    static inline constexpr uint8_t Count = 4;
+    static inline constexpr uint8_t Mask = (1 << Count) - 1;
+}
+
+// Optional core features, selected per instantiation so disabled ones cost nothing
+namespace Feature
+{
+    // Maintain state_hash()/display_hash() incrementally
+    static inline constexpr uint32_t StateHash = 1 << 0;
+    // Check the incremental hashes against a full recompute after every instruction, aborting
+    // on a mismatch (chip8fuzz --verify-hash)
+    static inline constexpr uint32_t VerifyStateHash = StateHash | (1 << 1);
+    // Report execution and memory accesses to the attached DebugHooks
+    static inline constexpr uint32_t Debugger = 1 << 2;
+}
+
+template <uint8_t QuirkFlags>
+struct Quirks
+{
+    static_assert((QuirkFlags & ~Quirk::Mask) == 0, "Unknown quirk flag");
+
+    static inline constexpr uint8_t Flags = QuirkFlags;
+    static inline constexpr bool ShiftUsesVX = (QuirkFlags & Quirk::ShiftUsesVX) != 0;
+    static inline constexpr bool LoadStoreKeepsI = (QuirkFlags & Quirk::LoadStoreKeepsI) != 0;
+    static inline constexpr bool JumpUsesVX = (QuirkFlags & Quirk::JumpUsesVX) != 0;
+    static inline constexpr bool WrapSprites = (QuirkFlags & Quirk::WrapSprites) != 0;
+};
+
+// Original COSMAC VIP interpreter
+template <uint8_t QuirkFlags = 0>
+struct CHIP8Platform : Quirks<QuirkFlags>
+{
+    static inline constexpr PlatformType Type = PlatformType::CHIP8;
+    static inline constexpr auto MemorySize = 4096;
+    static inline constexpr auto DisplayWidth = 64;
+    static inline constexpr auto DisplayHeight = 32;
+    static inline constexpr auto Planes = 1;
+    static inline constexpr auto FlagRegisterCount = 0;
+    static inline constexpr bool HighResolution = false;
+    static inline constexpr bool Extended = false;
+};
+
+// SUPER-CHIP 1.1 (HP48)
+template <uint8_t QuirkFlags = Quirk::ShiftUsesVX | Quirk::LoadStoreKeepsI | Quirk::JumpUsesVX>
+struct SuperChipPlatform : Quirks<QuirkFlags>
+{
+    static inline constexpr PlatformType Type = PlatformType::SuperChip;
+    static inline constexpr auto MemorySize = 4096;
+    static inline constexpr auto DisplayWidth = 128;
+    static inline constexpr auto DisplayHeight = 64;
+    static inline constexpr auto Planes = 1;
+    static inline constexpr auto FlagRegisterCount = 8;
+    static inline constexpr bool HighResolution = true;
+    static inline constexpr bool Extended = false;
+};
+
+// XO-CHIP (Octo)
+template <uint8_t QuirkFlags = Quirk::WrapSprites>
+struct XOChipPlatform : Quirks<QuirkFlags>
+{
+    static inline constexpr PlatformType Type = PlatformType::XOChip;
+    static inline constexpr auto MemorySize = 65536;
+    static inline constexpr auto DisplayWidth = 128;
+    static inline constexpr auto DisplayHeight = 64;
+    static inline constexpr auto Planes = 2;
+    static inline constexpr auto FlagRegisterCount = 16;
+    static inline constexpr bool HighResolution = true;
+    static inline constexpr bool Extended = true;
+};
+
+template <typename Platform>
+struct PlatformTag
+{
+    using type = Platform;
+};
+
+template <template <uint8_t> class PlatformTemplate, int QuirkFlags = 0, typename Visitor>
+static inline decltype(auto) dispatch_quirks(uint8_t quirks, Visitor&& visitor)
+{
+    if constexpr (QuirkFlags == Quirk::Mask)
+    {
+        return visitor(PlatformTag<PlatformTemplate<QuirkFlags>>{});
+    }
+    else
+    {
+        if (quirks == QuirkFlags)
+            return visitor(PlatformTag<PlatformTemplate<QuirkFlags>>{});
+
+        return dispatch_quirks<PlatformTemplate, QuirkFlags + 1>(quirks, visitor);
+    }
+}
+
+// Calls visitor(PlatformTag<Platform>{}) with the compile time platform policy matching
+// a runtime platform and quirk set, instantiating the visitor for every combination
+template <typename Visitor>
+static inline decltype(auto) dispatch_platform(PlatformType type, uint8_t quirks, Visitor&& visitor)
+{
+    quirks &= Quirk::Mask;
+
+    switch (type)
+    {
+    case PlatformType::SuperChip:
+        return dispatch_quirks<SuperChipPlatform>(quirks, visitor);
+
+    case PlatformType::XOChip:
+        return dispatch_quirks<XOChipPlatform>(quirks, visitor);
+
+    default:
+        return dispatch_quirks<CHIP8Platform>(quirks, visitor);
+    }
+}
+
+static inline constexpr auto MaxDisplayWidth = 128;
+static inline constexpr auto MaxDisplayHeight = 64;
+
+static inline constexpr uint8_t default_quirks(PlatformType type)
+{
+    switch (type)
+    {
+    case PlatformType::SuperChip:
+        return SuperChipPlatform<>::Flags;
+
+    case PlatformType::XOChip:
+        return XOChipPlatform<>::Flags;
+
+    default:
+        return CHIP8Platform<>::Flags;
+    }
+}
+
+static inline const char* platform_name(PlatformType type)
+{
+    switch (type)
+    {
+    case PlatformType::SuperChip:
+        return "SUPER-CHIP";
+
+    case PlatformType::XOChip:
+        return "XO-CHIP";
+
+    default:
+        return "CHIP-8";
+    }
+}
+
+// Guess the platform from the conventional ROM file extensions (.ch8, .sc8, .xo8)
+static inline PlatformType platform_from_file_name(const std::string& file_name)
+{
+    auto dot = file_name.find_last_of('.');
+    if (dot == std::string::npos)
+        return PlatformType::CHIP8;
+
+    std::string extension = file_name.substr(dot + 1);
+    for (auto& c : extension)
+        c = (char)std::tolower((unsigned char)c);
+
+    if (extension == "sc8" || extension == "sc")
+        return PlatformType::SuperChip;
+
+    if (extension == "xo8")
+        return PlatformType::XOChip;
+
+    return PlatformType::CHIP8;
+}
+
+// Platform names accepted on command lines and in manifests
+static inline bool parse_platform(const std::string& value, PlatformType& platform)
+{
+    if (value == "ch8" || value == "chip8")
+        platform = PlatformType::CHIP8;
+    else if (value == "sc8" || value == "schip")
+        platform = PlatformType::SuperChip;
+    else if (value == "xo8" || value == "xochip")
+        platform = PlatformType::XOChip;
+    else
+        return false;
+
+    return true;
+}
@@ -0,0 +1,427 @@
+#include "post_process.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || ((defined(__i386__) || defined(_M_IX86)) && (defined(__SSE2__) || _M_IX86_FP >= 2))
+#define POST_PROCESS_X86 1
+#include <emmintrin.h>
+#else
+#define POST_PROCESS_X86 0
+#endif
+
+// CRT stage channel factors out of 256: the aperture grille keeps one channel per column at
+// full strength and dims the other two, scanlines dim the last third of every source row
+static inline constexpr uint16_t GrilleDim = 184;
+static inline constexpr uint16_t ScanlineDim = 136;
+
+// Bytewise average rounding up, the same as _mm_avg_epu8
+static inline uint32_t average(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+static inline void scale2x_pixel(const uint32_t* p, int stride, uint32_t* out0, uint32_t* out1)
+{
+    const uint32_t B = p[-stride];
+    const uint32_t D = p[-1];
+    const uint32_t E = p[0];
+    const uint32_t F = p[1];
+    const uint32_t H = p[stride];
+
+    out0[0] = (D == B && B != F && D != H) ? D : E;
+    out0[1] = (B == F && B != D && F != H) ? F : E;
+    out1[0] = (D == H && D != B && H != F) ? D : E;
+    out1[1] = (H == F && D != H && B != F) ? F : E;
+}
+
+// Cells of a 4x4 block blended towards the edge color at its (3, 3) corner, mirrored for the
+// other corners. These are the xBR 4x weights of a diagonal edge: the corner cell takes the
+// edge color, the two cells next to it are blended half way.
+static const int SmoothFullCells[1][2] = { { 3, 3 } };
+static const int SmoothHalfCells[2][2] = { { 2, 3 }, { 3, 2 } };
+static const int SmoothCorners[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+
+static inline int smooth_cell(int corner, int x, int y)
+{
+    const int block_x = (SmoothCorners[corner][0] > 0) ? x : (3 - x);
+    const int block_y = (SmoothCorners[corner][1] > 0) ? y : (3 - y);
+
+    return (block_y * 4) + block_x;
+}
+
+// xBR level 1 edge rule for the corner of E towards (dx, dy), with pixel equality as the
+// color distance. Neighbours are named as in the xBR reference for the bottom right corner.
+static inline bool smooth_corner(const uint32_t* p, int stride, int dx, int dy)
+{
+    auto at = [&](int x, int y) { return p[(y * dy * stride) + (x * dx)]; };
+
+    const uint32_t E = at(0, 0);
+    const uint32_t F = at(1, 0);
+    const uint32_t H = at(0, 1);
+    if (E == F || E == H)
+        return false;
+
+    const uint32_t I = at(1, 1);
+    const int e = (E != at(1, -1)) + (E != at(-1, 1)) + (I != at(0, 2)) + (I != at(2, 0)) + 4 * (H != F);
+    const int i = (H != at(-1, 0)) + (H != at(1, 2)) + (F != at(2, 1)) + (F != at(0, -1)) + 4 * (E != I);
+
+    return e < i;
+}
+
+// Both F and H differ from E, so the xBR color choice d(E, F) <= d(E, H) always picks F
+static void smooth4x_pixel(const uint32_t* p, int stride, uint32_t* out, int out_stride)
+{
+    uint32_t block[16];
+    bool active[4];
+
+    for (int cell = 0; cell < 16; cell++)
+        block[cell] = p[0];
+
+    for (int corner = 0; corner < 4; corner++)
+        active[corner] = smooth_corner(p, stride, SmoothCorners[corner][0], SmoothCorners[corner][1]);
+
+    // Half cells first so the full cells of a neighbouring corner win
+    for (int corner = 0; corner < 4; corner++)
+    {
+        const uint32_t color = p[SmoothCorners[corner][0]];
+        for (const auto& cell : SmoothHalfCells)
+        {
+            if (active[corner])
+                block[smooth_cell(corner, cell[0], cell[1])] = average(p[0], color);
+        }
+    }
+
+    for (int corner = 0; corner < 4; corner++)
+    {
+        const uint32_t color = p[SmoothCorners[corner][0]];
+        for (const auto& cell : SmoothFullCells)
+        {
+            if (active[corner])
+                block[smooth_cell(corner, cell[0], cell[1])] = color;
+        }
+    }
+
+    for (int y = 0; y < 4; y++)
+        std::memcpy(out + (y * out_stride), block + (y * 4), 4 * sizeof(uint32_t));
+}
+
+static inline uint32_t apply_factors(uint32_t pixel, const uint16_t* factors)
+{
+    uint32_t result = 0;
+    for (int channel = 0; channel < 4; channel++)
+        result |= ((((pixel >> (channel * 8)) & 0xFF) * factors[channel]) >> 8) << (channel * 8);
+
+    return result;
+}
+
+#if POST_PROCESS_X86
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void scale2x_row(const uint32_t* row, int stride, int width, uint32_t* out0, uint32_t* out1)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const uint32_t* p = row + x;
+        const __m128i B = _mm_loadu_si128((const __m128i*)(p - stride));
+        const __m128i D = _mm_loadu_si128((const __m128i*)(p - 1));
+        const __m128i E = _mm_loadu_si128((const __m128i*)p);
+        const __m128i F = _mm_loadu_si128((const __m128i*)(p + 1));
+        const __m128i H = _mm_loadu_si128((const __m128i*)(p + stride));
+
+        const __m128i db = _mm_cmpeq_epi32(D, B);
+        const __m128i bf = _mm_cmpeq_epi32(B, F);
+        const __m128i dh = _mm_cmpeq_epi32(D, H);
+        const __m128i hf = _mm_cmpeq_epi32(H, F);
+
+        const __m128i e0 = select(_mm_andnot_si128(_mm_or_si128(bf, dh), db), D, E);
+        const __m128i e1 = select(_mm_andnot_si128(_mm_or_si128(db, hf), bf), F, E);
+        const __m128i e2 = select(_mm_andnot_si128(_mm_or_si128(db, hf), dh), D, E);
+        const __m128i e3 = select(_mm_andnot_si128(_mm_or_si128(dh, bf), hf), F, E);
+
+        _mm_storeu_si128((__m128i*)(out0 + (x * 2)), _mm_unpacklo_epi32(e0, e1));
+        _mm_storeu_si128((__m128i*)(out0 + (x * 2) + 4), _mm_unpackhi_epi32(e0, e1));
+        _mm_storeu_si128((__m128i*)(out1 + (x * 2)), _mm_unpacklo_epi32(e2, e3));
+        _mm_storeu_si128((__m128i*)(out1 + (x * 2) + 4), _mm_unpackhi_epi32(e2, e3));
+    }
+
+    for (; x < width; x++)
+        scale2x_pixel(row + x, stride, out0 + (x * 2), out1 + (x * 2));
+}
+
+static void smooth4x_row(const uint32_t* row, int stride, int width, uint32_t* out, int out_stride)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    auto distance = [&](__m128i a, __m128i b) { return _mm_add_epi32(one, _mm_cmpeq_epi32(a, b)); };
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const uint32_t* p = row + x;
+        const __m128i E = _mm_loadu_si128((const __m128i*)p);
+        __m128i cells[16];
+        __m128i masks[4];
+        __m128i colors[4];
+
+        for (int cell = 0; cell < 16; cell++)
+            cells[cell] = E;
+
+        for (int corner = 0; corner < 4; corner++)
+        {
+            const int dx = SmoothCorners[corner][0];
+            const int dy = SmoothCorners[corner][1];
+            auto at = [&](int x, int y) { return _mm_loadu_si128((const __m128i*)(p + (y * dy * stride) + (x * dx))); };
+
+            const __m128i F = at(1, 0);
+            const __m128i H = at(0, 1);
+            const __m128i I = at(1, 1);
+
+            __m128i e = _mm_add_epi32(distance(E, at(1, -1)), distance(E, at(-1, 1)));
+            e = _mm_add_epi32(e, _mm_add_epi32(distance(I, at(0, 2)), distance(I, at(2, 0))));
+            e = _mm_add_epi32(e, _mm_slli_epi32(distance(H, F), 2));
+
+            __m128i i = _mm_add_epi32(distance(H, at(-1, 0)), distance(H, at(1, 2)));
+            i = _mm_add_epi32(i, _mm_add_epi32(distance(F, at(2, 1)), distance(F, at(0, -1))));
+            i = _mm_add_epi32(i, _mm_slli_epi32(distance(E, I), 2));
+
+            masks[corner] = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(E, F), _mm_cmpeq_epi32(E, H)), _mm_cmplt_epi32(e, i));
+            colors[corner] = F;
+        }
+
+        for (int corner = 0; corner < 4; corner++)
+        {
+            const __m128i half = _mm_avg_epu8(E, colors[corner]);
+            for (const auto& cell : SmoothHalfCells)
+            {
+                __m128i& target = cells[smooth_cell(corner, cell[0], cell[1])];
+                target = select(masks[corner], half, target);
+            }
+        }
+
+        for (int corner = 0; corner < 4; corner++)
+        {
+            for (const auto& cell : SmoothFullCells)
+            {
+                __m128i& target = cells[smooth_cell(corner, cell[0], cell[1])];
+                target = select(masks[corner], colors[corner], target);
+            }
+        }
+
+        // Each vector holds one block cell of four pixels, transpose them into output rows
+        for (int y = 0; y < 4; y++)
+        {
+            const __m128i* source = cells + (y * 4);
+            const __m128i t0 = _mm_unpacklo_epi32(source[0], source[1]);
+            const __m128i t1 = _mm_unpacklo_epi32(source[2], source[3]);
+            const __m128i t2 = _mm_unpackhi_epi32(source[0], source[1]);
+            const __m128i t3 = _mm_unpackhi_epi32(source[2], source[3]);
+
+            __m128i* target = (__m128i*)(out + (y * out_stride) + (x * 4));
+            _mm_storeu_si128(target + 0, _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128(target + 1, _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128(target + 2, _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128(target + 3, _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+
+    for (; x < width; x++)
+        smooth4x_pixel(row + x, stride, out + (x * 4), out_stride);
+}
+
+// factors holds 12 pixels of 4 channel factors, the grille period rounded up to whole vectors
+static void crt_row(const uint32_t* source, const int* columns, const uint16_t* factors, int width, uint32_t* out)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_set_epi32((int)source[columns[x + 3]], (int)source[columns[x + 2]], (int)source[columns[x + 1]], (int)source[columns[x]]);
+        const uint16_t* phase = factors + ((x % 12) * 4);
+
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        low = _mm_srli_epi16(_mm_mullo_epi16(low, _mm_loadu_si128((const __m128i*)phase)), 8);
+        high = _mm_srli_epi16(_mm_mullo_epi16(high, _mm_loadu_si128((const __m128i*)(phase + 8))), 8);
+
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(low, high));
+    }
+
+    for (; x < width; x++)
+        out[x] = apply_factors(source[columns[x]], factors + ((x % 12) * 4));
+}
+
+#else
+
+static void scale2x_row(const uint32_t* row, int stride, int width, uint32_t* out0, uint32_t* out1)
+{
+    for (int x = 0; x < width; x++)
+        scale2x_pixel(row + x, stride, out0 + (x * 2), out1 + (x * 2));
+}
+
+static void smooth4x_row(const uint32_t* row, int stride, int width, uint32_t* out, int out_stride)
+{
+    for (int x = 0; x < width; x++)
+        smooth4x_pixel(row + x, stride, out + (x * 4), out_stride);
+}
+
+static void crt_row(const uint32_t* source, const int* columns, const uint16_t* factors, int width, uint32_t* out)
+{
+    for (int x = 0; x < width; x++)
+        out[x] = apply_factors(source[columns[x]], factors + ((x % 12) * 4));
+}
+
+#endif
+
+PostProcessor::PostProcessor(int threads)
+    : m_threads(threads)
+{
+}
+
+const uint32_t* PostProcessor::process(const uint32_t* source, int width, int height, int target_width, int target_height)
+{
+    if (!m_pool)
+        m_pool = std::make_unique<ThreadPool>(m_threads);
+
+    const uint32_t* image = source;
+
+    switch (m_filter)
+    {
+    case ScaleFilter::Scale2x:
+        image = scale2x(image, width, height, m_scaled[0]);
+        break;
+
+    case ScaleFilter::Scale4x:
+        image = scale2x(image, width, height, m_scaled[0]);
+        image = scale2x(image, width * 2, height * 2, m_scaled[1]);
+        break;
+
+    case ScaleFilter::Smooth4x:
+        image = smooth4x(image, width, height, m_scaled[0]);
+        break;
+
+    default:
+        break;
+    }
+
+    width *= scale_filter_factor(m_filter);
+    height *= scale_filter_factor(m_filter);
+
+    if (m_crt && target_width > 0 && target_height > 0)
+    {
+        image = crt(image, width, height, target_width, target_height);
+        width = target_width;
+        height = target_height;
+    }
+
+    m_output_width = width;
+    m_output_height = height;
+
+    return image;
+}
+
+const uint32_t* PostProcessor::pad(const uint32_t* source, int width, int height)
+{
+    const int stride = width + (Padding * 2);
+    m_padded.resize((size_t)stride * (height + (Padding * 2)));
+
+    for (int y = -Padding; y < height + Padding; y++)
+    {
+        const uint32_t* row = source + ((size_t)std::clamp(y, 0, height - 1) * width);
+        uint32_t* target = m_padded.data() + ((size_t)(y + Padding) * stride);
+
+        std::fill(target, target + Padding, row[0]);
+        std::memcpy(target + Padding, row, width * sizeof(uint32_t));
+        std::fill(target + Padding + width, target + stride, row[width - 1]);
+    }
+
+    return m_padded.data() + (Padding * stride) + Padding;
+}
+
+const uint32_t* PostProcessor::scale2x(const uint32_t* source, int width, int height, std::vector<uint32_t>& output)
+{
+    const uint32_t* padded = pad(source, width, height);
+    const int stride = width + (Padding * 2);
+    output.resize((size_t)width * height * 4);
+
+    m_pool->parallel_for(height, MinTilePixels / (width * 4), [&](int first, int last) {
+        for (int y = first; y < last; y++)
+        {
+            uint32_t* out = output.data() + ((size_t)y * 2 * width * 2);
+            scale2x_row(padded + ((size_t)y * stride), stride, width, out, out + (width * 2));
+        }
+    });
+
+    return output.data();
+}
+
+const uint32_t* PostProcessor::smooth4x(const uint32_t* source, int width, int height, std::vector<uint32_t>& output)
+{
+    const uint32_t* padded = pad(source, width, height);
+    const int stride = width + (Padding * 2);
+    output.resize((size_t)width * height * 16);
+
+    m_pool->parallel_for(height, MinTilePixels / (width * 16), [&](int first, int last) {
+        for (int y = first; y < last; y++)
+            smooth4x_row(padded + ((size_t)y * stride), stride, width, output.data() + ((size_t)y * 4 * width * 4), width * 4);
+    });
+
+    return output.data();
+}
+
+const uint32_t* PostProcessor::crt(const uint32_t* source, int width, int height, int target_width, int target_height)
+{
+    m_output.resize((size_t)target_width * target_height);
+
+    std::vector<int> columns(target_width);
+    for (int x = 0; x < target_width; x++)
+        columns[x] = (int)(((int64_t)x * width) / target_width);
+
+    // Per pixel B, G, R, A factors for 12 columns, full brightness rows and scanline rows
+    uint16_t factors[2][12 * 4];
+    for (int level = 0; level < 2; level++)
+    {
+        const uint32_t brightness = level ? ScanlineDim : 256;
+        for (int x = 0; x < 12; x++)
+        {
+            // ARGB pixels are B, G, R, A in memory, grille columns go R, G, B
+            for (int channel = 0; channel < 3; channel++)
+                factors[level][(x * 4) + channel] = (uint16_t)((((x % 3) == (2 - channel)) ? 256 : GrilleDim) * brightness / 256);
+            factors[level][(x * 4) + 3] = 256;
+        }
+    }
+
+    // Scanlines need at least two output rows per source row to show
+    const bool scanlines = target_height >= (height * 2);
+
+    m_pool->parallel_for(target_height, MinTilePixels / target_width, [&](int first, int last) {
+        // Rows from the same source row at the same level are identical, copy the last one
+        int cached_row[2] = { -1, -1 };
+        int cached_source[2] = { -1, -1 };
+
+        for (int y = first; y < last; y++)
+        {
+            const int64_t position = (int64_t)y * height;
+            const int source_row = (int)(position / target_height);
+            const int level = (scanlines && (position % target_height) * 3 >= (int64_t)target_height * 2) ? 1 : 0;
+            uint32_t* out = m_output.data() + ((size_t)y * target_width);
+
+            if (cached_source[level] == source_row)
+            {
+                std::memcpy(out, m_output.data() + ((size_t)cached_row[level] * target_width), target_width * sizeof(uint32_t));
+                continue;
+            }
+
+            crt_row(source + ((size_t)source_row * width), columns.data(), factors[level], target_width, out);
+            cached_row[level] = y;
+            cached_source[level] = source_row;
+        }
+    });
+
+    return m_output.data();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class ScaleFilter
+{
+    None,
+    // AdvMAME2x, and the same applied twice
+    Scale2x,
+    Scale4x,
+    // xBR style 4x: diagonal edges found with the xBR level 1 rule are cut and anti-aliased
+    Smooth4x
+};
+
+static inline constexpr int scale_filter_factor(ScaleFilter filter)
+{
+    switch (filter)
+    {
+    case ScaleFilter::Scale2x:
+        return 2;
+
+    case ScaleFilter::Scale4x:
+    case ScaleFilter::Smooth4x:
+        return 4;
+
+    default:
+        return 1;
+    }
+}
+
+static inline const char* scale_filter_name(ScaleFilter filter)
+{
+    switch (filter)
+    {
+    case ScaleFilter::Scale2x:
+        return "Scale2x";
+
+    case ScaleFilter::Scale4x:
+        return "Scale4x";
+
+    case ScaleFilter::Smooth4x:
+        return "xBR 4x";
+
+    default:
+        return "None";
+    }
+}
+
+// CPU post-processing of the ARGB screen buffer ahead of the texture upload. A scale filter
+// enlarges the display by an integer factor, the CRT stage then stretches the result to the
+// window size with scanlines and an aperture grille mask. Passes are SSE2 vectorized and
+// split into row tiles over a thread pool, started by the first process() call so nothing
+// runs while post-processing stays off.
+class PostProcessor
+{
+public:
+    explicit PostProcessor(int threads = 0);
+
+    void set_filter(ScaleFilter filter) { m_filter = filter; }
+    ScaleFilter filter() const { return m_filter; }
+    void set_crt(bool enabled) { m_crt = enabled; }
+    bool crt() const { return m_crt; }
+    bool enabled() const { return m_filter != ScaleFilter::None || m_crt; }
+    int threads() const { return m_pool ? m_pool->size() : ThreadPool::resolve_size(m_threads); }
+
+    // Returns the processed image, valid until the next call. Only the CRT stage uses the
+    // target size, without it the output is the source size times the filter factor.
+    const uint32_t* process(const uint32_t* source, int width, int height, int target_width, int target_height);
+    int output_width() const { return m_output_width; }
+    int output_height() const { return m_output_height; }
+
+private:
+    std::unique_ptr<ThreadPool> m_pool;
+    int m_threads = 0;
+    ScaleFilter m_filter = ScaleFilter::None;
+    bool m_crt = false;
+
+    std::vector<uint32_t> m_padded;
+    std::vector<uint32_t> m_scaled[2];
+    std::vector<uint32_t> m_output;
+    int m_output_width = 0;
+    int m_output_height = 0;
+
+    // Neighbours outside the image repeat the edge pixels
+    static inline constexpr auto Padding = 2;
+    // Rows of work below this many output pixels are not worth handing to another thread
+    static inline constexpr auto MinTilePixels = 16384;
+
+    const uint32_t* pad(const uint32_t* source, int width, int height);
+    const uint32_t* scale2x(const uint32_t* source, int width, int height, std::vector<uint32_t>& output);
+    const uint32_t* smooth4x(const uint32_t* source, int width, int height, std::vector<uint32_t>& output);
+    const uint32_t* crt(const uint32_t* source, int width, int height, int target_width, int target_height);
+};
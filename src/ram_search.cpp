@@ -0,0 +1,344 @@
+#include "ram_search.hpp"
+
+#include <bitset>
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || ((defined(__i386__) || defined(_M_IX86)) && (defined(__SSE2__) || _M_IX86_FP >= 2))
+#define RAM_SEARCH_X86 1
+#include <immintrin.h>
+#else
+#define RAM_SEARCH_X86 0
+#endif
+
+// AVX2 kernels are compiled regardless of the build flags and only called when the CPU has it
+#if RAM_SEARCH_X86 && !defined(_MSC_VER)
+#define RAM_SEARCH_AVX2 __attribute__((target("avx2")))
+#else
+#define RAM_SEARCH_AVX2
+#endif
+
+template <RamCompare Compare>
+static inline bool match_scalar(uint8_t current, uint8_t previous, uint8_t value)
+{
+    switch (Compare)
+    {
+    case RamCompare::Equal: return current == value;
+    case RamCompare::NotEqual: return current != value;
+    case RamCompare::Less: return current < value;
+    case RamCompare::Greater: return current > value;
+    case RamCompare::Unchanged: return current == previous;
+    case RamCompare::Changed: return current != previous;
+    case RamCompare::Increased: return current > previous;
+    case RamCompare::Decreased: return current < previous;
+    case RamCompare::ChangedBy: return (uint8_t)(current - previous) == value;
+    }
+
+    return false;
+}
+
+template <RamCompare Compare>
+static void filter_scalar(const uint8_t* memory, const uint8_t* previous, uint8_t value, uint64_t* bits, size_t words)
+{
+    for (size_t word = 0; word < words; word++)
+    {
+        if (bits[word] == 0)
+            continue;
+
+        uint64_t mask = 0;
+        for (int index = 0; index < 64; index++)
+        {
+            if (match_scalar<Compare>(memory[word * 64 + index], previous[word * 64 + index], value))
+                mask |= 1ull << index;
+        }
+
+        bits[word] &= mask;
+    }
+}
+
+#if RAM_SEARCH_X86
+
+// SSE2 and AVX2 only have signed byte compares, unsigned order goes through min/max
+template <RamCompare Compare>
+static inline __m128i match_sse2(__m128i current, __m128i previous, __m128i value)
+{
+    const __m128i operand = ram_compare_uses_previous(Compare) ? previous : value;
+    const __m128i equal = _mm_cmpeq_epi8(current, operand);
+
+    switch (Compare)
+    {
+    case RamCompare::Equal:
+    case RamCompare::Unchanged:
+        return equal;
+
+    case RamCompare::NotEqual:
+    case RamCompare::Changed:
+        return _mm_xor_si128(equal, _mm_set1_epi8(-1));
+
+    case RamCompare::Less:
+    case RamCompare::Decreased:
+        return _mm_andnot_si128(equal, _mm_cmpeq_epi8(_mm_min_epu8(current, operand), current));
+
+    case RamCompare::Greater:
+    case RamCompare::Increased:
+        return _mm_andnot_si128(equal, _mm_cmpeq_epi8(_mm_max_epu8(current, operand), current));
+
+    case RamCompare::ChangedBy:
+        return _mm_cmpeq_epi8(_mm_sub_epi8(current, previous), value);
+    }
+
+    return _mm_setzero_si128();
+}
+
+template <RamCompare Compare>
+static void filter_sse2(const uint8_t* memory, const uint8_t* previous, uint8_t value, uint64_t* bits, size_t words)
+{
+    const __m128i values = _mm_set1_epi8((char)value);
+
+    for (size_t word = 0; word < words; word++)
+    {
+        if (bits[word] == 0)
+            continue;
+
+        uint64_t mask = 0;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            const size_t offset = word * 64 + lane * 16;
+            const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(memory + offset));
+            const __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + offset));
+            mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(match_sse2<Compare>(current, last, values)) << (lane * 16);
+        }
+
+        bits[word] &= mask;
+    }
+}
+
+template <RamCompare Compare>
+RAM_SEARCH_AVX2 static inline __m256i match_avx2(__m256i current, __m256i previous, __m256i value)
+{
+    const __m256i operand = ram_compare_uses_previous(Compare) ? previous : value;
+    const __m256i equal = _mm256_cmpeq_epi8(current, operand);
+
+    switch (Compare)
+    {
+    case RamCompare::Equal:
+    case RamCompare::Unchanged:
+        return equal;
+
+    case RamCompare::NotEqual:
+    case RamCompare::Changed:
+        return _mm256_xor_si256(equal, _mm256_set1_epi8(-1));
+
+    case RamCompare::Less:
+    case RamCompare::Decreased:
+        return _mm256_andnot_si256(equal, _mm256_cmpeq_epi8(_mm256_min_epu8(current, operand), current));
+
+    case RamCompare::Greater:
+    case RamCompare::Increased:
+        return _mm256_andnot_si256(equal, _mm256_cmpeq_epi8(_mm256_max_epu8(current, operand), current));
+
+    case RamCompare::ChangedBy:
+        return _mm256_cmpeq_epi8(_mm256_sub_epi8(current, previous), value);
+    }
+
+    return _mm256_setzero_si256();
+}
+
+template <RamCompare Compare>
+RAM_SEARCH_AVX2 static void filter_avx2(const uint8_t* memory, const uint8_t* previous, uint8_t value, uint64_t* bits, size_t words)
+{
+    const __m256i values = _mm256_set1_epi8((char)value);
+
+    for (size_t word = 0; word < words; word++)
+    {
+        if (bits[word] == 0)
+            continue;
+
+        const size_t offset = word * 64;
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(memory + offset));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(memory + offset + 32));
+        const __m256i last_low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + offset));
+        const __m256i last_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + offset + 32));
+
+        const uint64_t mask_low = (uint32_t)_mm256_movemask_epi8(match_avx2<Compare>(low, last_low, values));
+        const uint64_t mask_high = (uint32_t)_mm256_movemask_epi8(match_avx2<Compare>(high, last_high, values));
+        bits[word] &= mask_low | (mask_high << 32);
+    }
+}
+
+static bool cpu_supports_avx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX2 also needs the OS to save the YMM registers
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (!os_saves_ymm)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool HasAvx2 = cpu_supports_avx2();
+
+#endif
+
+template <RamCompare Compare>
+static void filter_words(const uint8_t* memory, const uint8_t* previous, uint8_t value, uint64_t* bits, size_t words)
+{
+#if RAM_SEARCH_X86
+    if (HasAvx2)
+        filter_avx2<Compare>(memory, previous, value, bits, words);
+    else
+        filter_sse2<Compare>(memory, previous, value, bits, words);
+#else
+    filter_scalar<Compare>(memory, previous, value, bits, words);
+#endif
+}
+
+void RamSearch::reset(uint32_t memory_size)
+{
+    assert((memory_size % 64) == 0);
+
+    m_memory_size = memory_size;
+    m_bits.assign(memory_size / 64, ~0ull);
+}
+
+void RamSearch::filter(const uint8_t* memory, const uint8_t* previous, RamCompare compare, uint8_t value)
+{
+    assert(memory && (previous || !ram_compare_uses_previous(compare)));
+
+    // Value compares still load previous, point it somewhere valid
+    if (!previous)
+        previous = memory;
+
+    uint64_t* bits = m_bits.data();
+    const size_t words = m_bits.size();
+
+    switch (compare)
+    {
+    case RamCompare::Equal: filter_words<RamCompare::Equal>(memory, previous, value, bits, words); break;
+    case RamCompare::NotEqual: filter_words<RamCompare::NotEqual>(memory, previous, value, bits, words); break;
+    case RamCompare::Less: filter_words<RamCompare::Less>(memory, previous, value, bits, words); break;
+    case RamCompare::Greater: filter_words<RamCompare::Greater>(memory, previous, value, bits, words); break;
+    case RamCompare::Unchanged: filter_words<RamCompare::Unchanged>(memory, previous, value, bits, words); break;
+    case RamCompare::Changed: filter_words<RamCompare::Changed>(memory, previous, value, bits, words); break;
+    case RamCompare::Increased: filter_words<RamCompare::Increased>(memory, previous, value, bits, words); break;
+    case RamCompare::Decreased: filter_words<RamCompare::Decreased>(memory, previous, value, bits, words); break;
+    case RamCompare::ChangedBy: filter_words<RamCompare::ChangedBy>(memory, previous, value, bits, words); break;
+    }
+}
+
+uint32_t RamSearch::count() const
+{
+    uint32_t total = 0;
+    for (uint64_t word : m_bits)
+        total += (uint32_t)std::bitset<64>(word).count();
+
+    return total;
+}
+
+void RamSearch::remove(uint32_t address)
+{
+    if (address < m_memory_size)
+        m_bits[address / 64] &= ~(1ull << (address % 64));
+}
+
+std::vector<uint32_t> RamSearch::addresses(size_t limit) const
+{
+    std::vector<uint32_t> result;
+
+    for (size_t word = 0; word < m_bits.size() && result.size() < limit; word++)
+    {
+        for (uint64_t bits = m_bits[word]; bits != 0 && result.size() < limit; bits &= bits - 1)
+            result.push_back((uint32_t)(word * 64 + count_trailing_zeros(bits)));
+    }
+
+    return result;
+}
+
+void RamSearchBatch::add_instance(const Machine& machine)
+{
+    Instance instance;
+    instance.machine = &machine;
+    instance.search.reset(machine.memory_size());
+    instance.history.emplace_back(machine.get_memory(), machine.get_memory() + machine.memory_size());
+
+    m_instances.push_back(std::move(instance));
+}
+
+void RamSearchBatch::clear()
+{
+    m_instances.clear();
+}
+
+void RamSearchBatch::reset()
+{
+    for (auto& instance : m_instances)
+    {
+        const uint8_t* memory = instance.machine->get_memory();
+
+        instance.search.reset(instance.machine->memory_size());
+        instance.history.resize(1);
+        std::memcpy(instance.history[0].data(), memory, instance.history[0].size());
+    }
+}
+
+bool RamSearchBatch::capture()
+{
+    bool captured = true;
+
+    for (auto& instance : m_instances)
+    {
+        const uint8_t* memory = instance.machine->get_memory();
+        auto& history = instance.history;
+
+        if (std::memcmp(memory, history.back().data(), history.back().size()) == 0)
+            continue;
+
+        if (history.size() >= MaxSnapshots)
+        {
+            captured = false;
+            continue;
+        }
+
+        history.emplace_back(memory, memory + instance.machine->memory_size());
+    }
+
+    return captured;
+}
+
+void RamSearchBatch::filter(RamCompare compare, uint8_t value)
+{
+    for (auto& instance : m_instances)
+    {
+        const uint8_t* memory = instance.machine->get_memory();
+        auto& history = instance.history;
+
+        if (ram_compare_uses_previous(compare))
+        {
+            for (size_t index = 1; index < history.size(); index++)
+                instance.search.filter(history[index].data(), history[index - 1].data(), compare, value);
+
+            // A capture taken at the current state is already the last sample
+            if (history.size() == 1 || std::memcmp(memory, history.back().data(), history.back().size()) != 0)
+                instance.search.filter(memory, history.back().data(), compare, value);
+        }
+        else
+        {
+            instance.search.filter(memory, nullptr, compare, value);
+        }
+
+        // The oldest snapshot buffer becomes the new baseline
+        history.resize(1);
+        std::memcpy(history[0].data(), memory, history[0].size());
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "machine.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum class RamCompare
+{
+    // Against a value
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    // Against the previous snapshot
+    Unchanged,
+    Changed,
+    Increased,
+    Decreased,
+    // Current minus previous equals the value, wrapping (0xFF is a decrease by one)
+    ChangedBy
+};
+
+static inline constexpr bool ram_compare_uses_previous(RamCompare compare)
+{
+    return compare >= RamCompare::Unchanged;
+}
+
+// Candidate addresses of one memory image, one bit per byte. Filters are vectorized
+// 64 bytes at a time and skip blocks without candidates left. Memory sizes are a
+// multiple of 64, as every platform memory size is.
+class RamSearch
+{
+public:
+    void reset(uint32_t memory_size);
+    // previous is only read by the relative compares
+    void filter(const uint8_t* memory, const uint8_t* previous, RamCompare compare, uint8_t value = 0);
+
+    uint32_t memory_size() const { return m_memory_size; }
+    uint32_t count() const;
+    bool is_candidate(uint32_t address) const { return address < m_memory_size && ((m_bits[address / 64] >> (address % 64)) & 1) != 0; }
+    void remove(uint32_t address);
+    const std::vector<uint64_t>& bits() const { return m_bits; }
+
+    // Candidates in ascending order, at most limit of them
+    std::vector<uint32_t> addresses(size_t limit = SIZE_MAX) const;
+
+    template <typename Callback>
+    void for_each_candidate(Callback&& callback) const
+    {
+        for (size_t word = 0; word < m_bits.size(); word++)
+        {
+            for (uint64_t bits = m_bits[word]; bits != 0; bits &= bits - 1)
+                callback((uint32_t)(word * 64 + count_trailing_zeros(bits)));
+        }
+    }
+
+private:
+    std::vector<uint64_t> m_bits;
+    uint32_t m_memory_size = 0;
+
+    static int count_trailing_zeros(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward64(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+};
+
+// Searches many machines at once. Each instance keeps the snapshots captured since
+// its last filter: relative compares must hold between every consecutive pair of
+// them, followed by the current memory when it differs from the last capture. Value
+// compares are checked on the current memory. A capture identical to the previous
+// snapshot is not stored: when no byte of memory moved, nothing increased, decreased
+// or changed, and keeping the pair would make those compares reject every address.
+// "Increased at every step" therefore means at every captured step where memory
+// changed at all. Filtering consumes the history and keeps the current memory as the
+// next baseline.
+class RamSearchBatch
+{
+public:
+    void add_instance(const Machine& machine);
+    void clear();
+    void reset();
+
+    // Returns false once an instance holds MaxSnapshots, filter before capturing again
+    bool capture();
+    void filter(RamCompare compare, uint8_t value = 0);
+
+    int count() const { return (int)m_instances.size(); }
+    const RamSearch& search(int index) const { return m_instances[index].search; }
+    RamSearch& search(int index) { return m_instances[index].search; }
+    size_t history_size(int index) const { return m_instances[index].history.size(); }
+
+    // Snapshots kept per instance, baseline included, 4 MB for an XO-CHIP instance
+    static inline constexpr size_t MaxSnapshots = 64;
+
+private:
+    struct Instance
+    {
+        const Machine* machine = nullptr;
+        RamSearch search;
+        std::vector<std::vector<uint8_t>> history;
+    };
+
+    std::vector<Instance> m_instances;
+};
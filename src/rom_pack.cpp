@@ -0,0 +1,209 @@
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+RomPack::RomPack()
+{
+}
+
+bool RomPack::open(const std::string& path)
+{
+    close();
+
+    if (!m_file.open(path))
+        return false;
+
+    if (m_file.size() < sizeof(RomPackHeader))
+    {
+        close();
+        return false;
+    }
+
+    RomPackHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (!validate(header))
+    {
+        close();
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const RomPackEntry*>(m_file.data() + header.index_offset);
+    m_names = reinterpret_cast<const char*>(m_file.data() + header.names_offset);
+    m_names_size = header.names_size;
+    m_count = header.entry_count;
+
+    return true;
+}
+
+void RomPack::close()
+{
+    m_file.close();
+    m_entries = nullptr;
+    m_names = nullptr;
+    m_names_size = 0;
+    m_count = 0;
+}
+
+bool RomPack::validate(const RomPackHeader& header) const
+{
+    const uint64_t file_size = m_file.size();
+
+    if (header.magic != RomPackMagic || header.version != RomPackVersion)
+        return false;
+
+    if ((header.index_offset % alignof(RomPackEntry)) != 0)
+        return false;
+
+    if ((uint64_t)header.index_offset + (uint64_t)header.entry_count * sizeof(RomPackEntry) > file_size)
+        return false;
+
+    if ((uint64_t)header.names_offset + header.names_size > file_size)
+        return false;
+
+    // Names table must end with a terminator so rom_name() never runs past it
+    if (header.names_size == 0 || m_file.data()[header.names_offset + header.names_size - 1] != '\0')
+        return false;
+
+    // Entries are checked once here so lookups never have to
+    const RomPackEntry* entries = reinterpret_cast<const RomPackEntry*>(m_file.data() + header.index_offset);
+    for (uint32_t index = 0; index < header.entry_count; index++)
+    {
+        const RomPackEntry& entry = entries[index];
+
+        if ((uint64_t)entry.data_offset + entry.data_size > file_size)
+            return false;
+
+        if (entry.name_offset >= header.names_size)
+            return false;
+
+        if (entry.platform > (uint8_t)PlatformType::XOChip)
+            return false;
+
+        if (index > 0 && entries[index - 1].hash >= entry.hash)
+            return false;
+    }
+
+    return true;
+}
+
+const RomPackEntry* RomPack::find(uint64_t hash) const
+{
+    const RomPackEntry* end = m_entries + m_count;
+    const RomPackEntry* entry = std::lower_bound(m_entries, end, hash,
+        [](const RomPackEntry& entry, uint64_t hash) { return entry.hash < hash; });
+
+    if (entry == end || entry->hash != hash)
+        return nullptr;
+
+    return entry;
+}
+
+const char* RomPack::rom_name(const RomPackEntry& entry) const
+{
+    return m_names + entry.name_offset;
+}
+
+RomMetadata RomPack::metadata(const RomPackEntry& entry) const
+{
+    RomMetadata metadata;
+    metadata.platform = (PlatformType)entry.platform;
+    metadata.quirks = entry.quirks & Quirk::Mask;
+    metadata.instructions_per_second = entry.instructions_per_second;
+    std::memcpy(metadata.key_layout, entry.key_layout, sizeof(metadata.key_layout));
+
+    return metadata;
+}
+
+bool RomPackBuilder::add(const std::string& name, const uint8_t* data, uint32_t size, const RomMetadata& metadata)
+{
+    uint64_t hash = hash_rom(data, size);
+    if (!m_hashes.insert(hash).second)
+        return false;
+
+    m_roms.push_back({ hash, name, std::vector<uint8_t>(data, data + size), metadata });
+
+    return true;
+}
+
+bool RomPackBuilder::write(const std::string& path) const
+{
+    std::vector<const Rom*> roms;
+    for (const auto& rom : m_roms)
+        roms.push_back(&rom);
+
+    std::sort(roms.begin(), roms.end(), [](const Rom* a, const Rom* b) { return a->hash < b->hash; });
+
+    RomPackHeader header;
+    header.entry_count = (uint32_t)roms.size();
+    header.index_offset = sizeof(RomPackHeader);
+    header.names_offset = header.index_offset + header.entry_count * sizeof(RomPackEntry);
+
+    std::string names;
+    std::vector<RomPackEntry> entries(roms.size());
+    for (size_t index = 0; index < roms.size(); index++)
+    {
+        entries[index].name_offset = (uint32_t)names.size();
+        names += roms[index]->name;
+        names += '\0';
+    }
+    if (names.empty())
+        names += '\0';
+
+    header.names_size = (uint32_t)names.size();
+
+    uint64_t data_offset = (uint64_t)header.names_offset + header.names_size;
+    for (size_t index = 0; index < roms.size(); index++)
+    {
+        const Rom& rom = *roms[index];
+        RomPackEntry& entry = entries[index];
+
+        if (data_offset + rom.data.size() > UINT32_MAX)
+            return false;
+
+        entry.hash = rom.hash;
+        entry.data_offset = (uint32_t)data_offset;
+        entry.data_size = (uint32_t)rom.data.size();
+        entry.instructions_per_second = rom.metadata.instructions_per_second;
+        entry.platform = (uint8_t)rom.metadata.platform;
+        entry.quirks = rom.metadata.quirks;
+        std::memcpy(entry.key_layout, rom.metadata.key_layout, sizeof(entry.key_layout));
+
+        data_offset += rom.data.size();
+    }
+
+    std::ofstream file(path, std::ofstream::binary | std::ofstream::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(RomPackEntry));
+    file.write(names.data(), names.size());
+    for (const Rom* rom : roms)
+        file.write(reinterpret_cast<const char*>(rom->data.data()), rom->data.size());
+
+    return file.good();
+}
+
+RomMetadata resolve_rom_metadata(const std::string& path, const uint8_t* data, size_t size, const RomPack& pack)
+{
+    const RomPackEntry* entry = pack.is_open() ? pack.find(hash_rom(data, size)) : nullptr;
+    if (entry)
+        return pack.metadata(*entry);
+
+    RomMetadata metadata;
+    metadata.platform = platform_from_file_name(path);
+    metadata.quirks = default_quirks(metadata.platform);
+    return metadata;
+}
+
+bool resolve_rom_metadata(const std::string& path, const uint8_t* data, size_t size, const std::string& pack_path, RomMetadata& metadata)
+{
+    RomPack pack;
+    if (!pack_path.empty() && !pack.open(pack_path))
+        return false;
+
+    metadata = resolve_rom_metadata(path, data, size, pack);
+    return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "platform.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Packed ROM archive, memory mapped and indexed by content hash.
+//
+// Layout (little endian):
+//   RomPackHeader
+//   RomPackEntry[entry_count]   sorted by hash
+//   names                       NUL terminated strings
+//   ROM data
+//
+// ROM data is loaded straight from the mapping into a core without intermediate copies.
+
+static inline constexpr uint32_t RomPackMagic = 0x4B503843; // "C8PK"
+static inline constexpr uint32_t RomPackVersion = 1;
+
+struct RomPackHeader
+{
+    uint32_t magic = RomPackMagic;
+    uint32_t version = RomPackVersion;
+    uint32_t entry_count = 0;
+    uint32_t index_offset = 0;
+    uint32_t names_offset = 0;
+    uint32_t names_size = 0;
+};
+
+// Per ROM metadata, stored in the pack and used by the frontend to pick the core
+struct RomMetadata
+{
+    PlatformType platform = PlatformType::CHIP8;
+    uint8_t quirks = 0;
+    // Preferred instructions per second, 0 selects the frontend default
+    uint16_t instructions_per_second = 0;
+    // CHIP-8 key produced by each host keyboard grid position (1234/QWER/ASDF/ZXCV), one nibble each
+    uint8_t key_layout[8] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+};
+
+// Frames run per second, in step with the 60 Hz timers, and the speed of ROMs without a preferred one
+static inline constexpr int FramesPerSecond = 60;
+static inline constexpr int DefaultInstructionsPerSecond = 540;
+
+// Manifest speed value, decimal or 0x hex, from 1 to UINT16_MAX
+static inline bool parse_instructions_per_second(const std::string& text, uint16_t& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    const unsigned long long number = std::strtoull(text.c_str(), &end, 0);
+    if (*end != 0 || text[0] == '-' || number == 0 || number > UINT16_MAX)
+        return false;
+
+    value = (uint16_t)number;
+    return true;
+}
+
+// Instructions run per frame: the given speed when not 0, else the ROM's preferred speed or the default
+static inline int instructions_per_frame(const RomMetadata& metadata, int instructions_per_second = 0)
+{
+    if (instructions_per_second == 0)
+        instructions_per_second = metadata.instructions_per_second;
+    if (instructions_per_second == 0)
+        instructions_per_second = DefaultInstructionsPerSecond;
+
+    return std::max(1, instructions_per_second / FramesPerSecond);
+}
+
+struct RomPackEntry
+{
+    uint64_t hash = 0;
+    uint32_t data_offset = 0;
+    uint32_t data_size = 0;
+    uint32_t name_offset = 0;
+    uint16_t instructions_per_second = 0;
+    uint8_t platform = 0;
+    uint8_t quirks = 0;
+    uint8_t key_layout[8] = { 0 };
+};
+
+static_assert(sizeof(RomPackHeader) == 24, "Unexpected RomPackHeader layout");
+static_assert(sizeof(RomPackEntry) == 32, "Unexpected RomPackEntry layout");
+
+// 64 bit FNV-1a of the ROM contents
+static inline uint64_t hash_rom(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t index = 0; index < size; index++)
+    {
+        hash ^= data[index];
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+class RomPack
+{
+public:
+    RomPack();
+
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return m_entries != nullptr; }
+
+    uint32_t count() const { return m_count; }
+    const RomPackEntry& entry(uint32_t index) const { return m_entries[index]; }
+    const RomPackEntry* find(uint64_t hash) const;
+
+    const uint8_t* rom_data(const RomPackEntry& entry) const { return m_file.data() + entry.data_offset; }
+    const char* rom_name(const RomPackEntry& entry) const;
+    RomMetadata metadata(const RomPackEntry& entry) const;
+
+private:
+    MappedFile m_file;
+    const RomPackEntry* m_entries = nullptr;
+    const char* m_names = nullptr;
+    uint32_t m_names_size = 0;
+    uint32_t m_count = 0;
+
+    bool validate(const RomPackHeader& header) const;
+};
+
+class RomPackBuilder
+{
+public:
+    // Returns false when a ROM with the same contents was already added
+    bool add(const std::string& name, const uint8_t* data, uint32_t size, const RomMetadata& metadata);
+    bool write(const std::string& path) const;
+    uint32_t count() const { return (uint32_t)m_roms.size(); }
+    bool contains(uint64_t hash) const { return m_hashes.count(hash) != 0; }
+
+private:
+    struct Rom
+    {
+        uint64_t hash;
+        std::string name;
+        std::vector<uint8_t> data;
+        RomMetadata metadata;
+    };
+
+    std::vector<Rom> m_roms;
+    std::unordered_set<uint64_t> m_hashes;
+};
+
+// Metadata of a ROM: its pack entry when the pack has the same contents, otherwise the
+// platform guessed from the file name with its default quirks
+RomMetadata resolve_rom_metadata(const std::string& path, const uint8_t* data, size_t size, const RomPack& pack);
+// Same, opening the pack first unless pack_path is empty; false when the pack cannot be opened
+bool resolve_rom_metadata(const std::string& path, const uint8_t* data, size_t size, const std::string& pack_path, RomMetadata& metadata);
@@ -1,5 +1,7 @@
 #include "sound.hpp"
 #include <string>
+#include <cstring>
+#include <cmath>
 
 int calculate_offset(Sound* device, int sample, int channel)
 {
@@ -73,8 +75,33 @@ void Sound::stop()
     SDL_PauseAudioDevice(m_audio_device, 1);
 }
 
+void Sound::set_pattern(const uint8_t* pattern, uint8_t pitch)
+{
+    bool enabled = (pattern != nullptr);
+    if (enabled == m_pattern_enabled && pitch == m_pitch &&
+        (!enabled || std::memcmp(pattern, m_pattern, PatternSize) == 0))
+        return;
+
+    SDL_LockAudioDevice(m_audio_device);
+    if (enabled)
+        std::memcpy(m_pattern, pattern, PatternSize);
+    m_pattern_enabled = enabled;
+    m_pitch = pitch;
+    SDL_UnlockAudioDevice(m_audio_device);
+}
+
 double Sound::get_sample()
 {
+    if (m_pattern_enabled)
+    {
+        // Pattern bits are played at 4000 * 2^((pitch - 64) / 48) bits per second
+        double bit_rate = 4000.0 * std::pow(2.0, (m_pitch - 64) / 48.0);
+        m_pattern_position = std::fmod(m_pattern_position + bit_rate / m_audio_spec.freq, PatternSize * 8);
+
+        int bit = (int)m_pattern_position;
+        return ((m_pattern[bit / 8] >> (7 - (bit % 8))) & 1) ? 0.5 : -0.5;
+    }
+
     double sample_rate = (double)(m_audio_spec.freq);
     double period = sample_rate / 800;
 
@@ -12,6 +12,7 @@ public:
     bool init();
     void play();
     void stop();
+    void set_pattern(const uint8_t* pattern, uint8_t pitch);
 
     const SDL_AudioSpec& get_audio_spec() const { return m_audio_spec; }
     double get_sample();
@@ -20,4 +21,11 @@ private:
     SDL_AudioSpec m_audio_spec {};
     SDL_AudioDeviceID m_audio_device = 0;
     int m_position = 0;
+
+    // XO-CHIP 1-bit audio pattern, played instead of the default tone when set
+    static inline constexpr auto PatternSize = 16;
+    uint8_t m_pattern[PatternSize] = { 0 };
+    bool m_pattern_enabled = false;
+    uint8_t m_pitch = 64;
+    double m_pattern_position = 0.0;
 };
@@ -0,0 +1,180 @@
+#include "terminal_view.hpp"
+#include "palette.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+// Braille dot bit for each pixel of a 2x4 cell, by row then column
+static const uint8_t BrailleDots[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+
+static void append_color(std::string& output, int layer, int color)
+{
+    const uint32_t rgb = DisplayPalette[color & 3];
+
+    char text[32];
+    const int size = std::snprintf(text, sizeof(text), "\x1b[%d;2;%u;%u;%um", layer, (rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+    output.append(text, size);
+}
+
+TerminalView::TerminalView(TerminalCells cells)
+    : m_mode(cells)
+{
+}
+
+void TerminalView::resize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    grid_size(m_mode, width, height, m_columns, m_rows);
+
+    m_cells.assign((size_t)m_columns * m_rows, 0);
+    m_valid = false;
+}
+
+void TerminalView::set_cells(TerminalCells cells)
+{
+    m_mode = cells;
+    resize(m_width, m_height);
+}
+
+void TerminalView::grid_size(TerminalCells cells, int width, int height, int& columns, int& rows)
+{
+    if (cells == TerminalCells::Braille)
+    {
+        columns = (width + 1) / 2;
+        rows = (height + 3) / 4;
+    }
+    else
+    {
+        columns = width;
+        rows = (height + 1) / 2;
+    }
+}
+
+// Half blocks pack the top and bottom pixel values, braille the dots and their color
+uint16_t TerminalView::cell_at(const uint8_t* display, int column, int row) const
+{
+    auto pixel = [&](int x, int y) { return (x < m_width && y < m_height) ? (display[(y * m_width) + x] & 3) : 0; };
+
+    if (m_mode == TerminalCells::HalfBlocks)
+        return (uint16_t)((pixel(column, row * 2) << 2) | pixel(column, (row * 2) + 1));
+
+    uint16_t dots = 0;
+    int color = 0;
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 2; x++)
+        {
+            const int value = pixel((column * 2) + x, (row * 4) + y);
+            if (value != 0)
+            {
+                dots |= BrailleDots[y][x];
+                color = std::max(color, value);
+            }
+        }
+    }
+
+    return (uint16_t)(dots | (color << 8));
+}
+
+void TerminalView::move_to(int row, int column, std::string& output)
+{
+    if (row == m_cursor_row && column == m_cursor_column)
+        return;
+
+    char text[32];
+    int size = 0;
+    if (row == m_cursor_row && column > m_cursor_column)
+        size = std::snprintf(text, sizeof(text), "\x1b[%dC", column - m_cursor_column);
+    else
+        size = std::snprintf(text, sizeof(text), "\x1b[%d;%dH", row + 1, column + 1);
+
+    output.append(text, size);
+    m_cursor_row = row;
+    m_cursor_column = column;
+}
+
+void TerminalView::set_colors(int foreground, int background, std::string& output)
+{
+    if (foreground >= 0 && foreground != m_foreground)
+    {
+        append_color(output, 38, foreground);
+        m_foreground = foreground;
+    }
+
+    if (background >= 0 && background != m_background)
+    {
+        append_color(output, 48, background);
+        m_background = background;
+    }
+}
+
+void TerminalView::write_cell(uint16_t cell, std::string& output)
+{
+    if (m_mode == TerminalCells::HalfBlocks)
+    {
+        const int top = (cell >> 2) & 3;
+        const int bottom = cell & 3;
+
+        // Solid cells only need the background, whatever the foreground is
+        if (top == bottom)
+        {
+            set_colors(-1, bottom, output);
+            output += ' ';
+        }
+        else
+        {
+            set_colors(top, bottom, output);
+            output += "\xE2\x96\x80";
+        }
+    }
+    else
+    {
+        const uint8_t dots = cell & 0xFF;
+
+        set_colors(dots ? (cell >> 8) : -1, 0, output);
+        if (dots == 0)
+        {
+            output += ' ';
+        }
+        else
+        {
+            // U+2800 + dots in UTF-8
+            output += '\xE2';
+            output += (char)(0xA0 | (dots >> 6));
+            output += (char)(0x80 | (dots & 0x3F));
+        }
+    }
+
+    m_cursor_column++;
+}
+
+void TerminalView::render(const uint8_t* display, std::string& output)
+{
+    const size_t start = output.size();
+    m_cursor_row = -1;
+    m_cursor_column = -1;
+    m_foreground = -1;
+    m_background = -1;
+
+    for (int row = 0; row < m_rows; row++)
+    {
+        for (int column = 0; column < m_columns; column++)
+        {
+            const uint16_t cell = cell_at(display, column, row);
+            uint16_t& previous = m_cells[((size_t)row * m_columns) + column];
+            if (m_valid && cell == previous)
+                continue;
+
+            previous = cell;
+            move_to(row, column, output);
+            write_cell(cell, output);
+        }
+    }
+
+    m_valid = true;
+
+    // Leave the attributes as they were for whatever else writes to the terminal
+    if (output.size() != start)
+        output += "\x1b[0m";
+}
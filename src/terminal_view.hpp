@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TerminalCells
+{
+    // One cell per 1x2 pixels, an upper half block in the top pixel color over the bottom pixel color
+    HalfBlocks,
+    // One cell per 2x4 pixels, braille dots for the lit pixels
+    Braille
+};
+
+// Renders displays as ANSI escape sequences, emitting only the cells that changed since the
+// previous frame. Runs of changed cells are joined by cursor forward moves within a row and
+// colors are only set when they change, so a frame costs bytes in proportion to what moved.
+class TerminalView
+{
+public:
+    explicit TerminalView(TerminalCells cells = TerminalCells::HalfBlocks);
+
+    // Display size in pixels, also invalidates the terminal contents
+    void resize(int width, int height);
+    // Switches the cell type, also invalidates the terminal contents
+    void set_cells(TerminalCells cells);
+    TerminalCells cells() const { return m_mode; }
+    // Terminal cells taken by a display of width x height pixels
+    static void grid_size(TerminalCells cells, int width, int height, int& columns, int& rows);
+    // The next frame redraws every cell, e.g. after the terminal was resized or cleared
+    void invalidate() { m_valid = false; }
+
+    // Appends the sequences that update the terminal from the previous frame to this display
+    void render(const uint8_t* display, std::string& output);
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+private:
+    TerminalCells m_mode;
+    int m_width = 0;
+    int m_height = 0;
+    int m_columns = 0;
+    int m_rows = 0;
+    bool m_valid = false;
+    std::vector<uint16_t> m_cells;
+
+    // Terminal state while a frame is written, -1 when unknown
+    int m_cursor_row = -1;
+    int m_cursor_column = -1;
+    int m_foreground = -1;
+    int m_background = -1;
+
+    uint16_t cell_at(const uint8_t* display, int column, int row) const;
+    void move_to(int row, int column, std::string& output);
+    void set_colors(int foreground, int background, std::string& output);
+    void write_cell(uint16_t cell, std::string& output);
+};
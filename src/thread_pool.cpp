@@ -0,0 +1,87 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads)
+{
+    threads = resolve_size(threads);
+    for (int index = 1; index < threads; index++)
+        m_workers.emplace_back(&ThreadPool::worker_main, this);
+}
+
+int ThreadPool::resolve_size(int threads)
+{
+    return (threads > 0) ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_start.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::parallel_for(int count, int grain, const std::function<void(int, int)>& task)
+{
+    grain = std::max(1, grain);
+    if (count <= 0)
+        return;
+
+    if (m_workers.empty() || count <= grain)
+    {
+        task(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_count = count;
+        // A few chunks per thread so uneven ranges still balance
+        m_chunk = std::max(grain, count / (size() * 4));
+        m_next = 0;
+        m_running = (int)m_workers.size();
+        m_generation++;
+    }
+
+    m_start.notify_all();
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_running == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::worker_main()
+{
+    uint64_t generation = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+            if (m_stop)
+                return;
+
+            generation = m_generation;
+        }
+
+        run_chunks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_running == 0)
+            m_done.notify_one();
+    }
+}
+
+void ThreadPool::run_chunks()
+{
+    for (int first = m_next.fetch_add(m_chunk); first < m_count; first = m_next.fetch_add(m_chunk))
+        (*m_task)(first, std::min(first + m_chunk, m_count));
+}
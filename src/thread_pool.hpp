@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed set of worker threads for splitting one job into ranges, the calling thread
+// works on the job too. Only one parallel_for runs at a time.
+class ThreadPool
+{
+public:
+    // 0 threads uses one per hardware thread, the caller included
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)m_workers.size() + 1; }
+    // Threads a pool created with this count has, the caller included
+    static int resolve_size(int threads);
+
+    // Calls task(first, last) over [0, count) in ranges of at least grain items and returns
+    // once all of them are done. Small jobs run on the calling thread only.
+    void parallel_for(int count, int grain, const std::function<void(int, int)>& task);
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+
+    const std::function<void(int, int)>* m_task = nullptr;
+    int m_count = 0;
+    int m_chunk = 0;
+    std::atomic<int> m_next { 0 };
+    int m_running = 0;
+    uint64_t m_generation = 0;
+    bool m_stop = false;
+
+    void worker_main();
+    void run_chunks();
+};
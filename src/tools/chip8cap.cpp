@@ -0,0 +1,277 @@
+// chip8cap: records, inspects and exports session captures
+//
+//   chip8cap record <rom> <capture> [--frames N] [--pack <file>] [--seed N]
+//   chip8cap info <capture>
+//   chip8cap export <capture> <output> [--format png|pbm|raw] [--scale N] [--first N] [--count N]
+//
+// PNG and PBM exports write one numbered file per frame (<output>_000000.png, ...).
+// Raw export writes rgb24 frames back to back, "-" writes them to stdout, e.g.
+//   chip8cap export game.c8c - --format raw | ffmpeg -f rawvideo -pix_fmt rgb24 -s 64x32 -r 60 -i - game.mp4
+
+#include "capture.hpp"
+#include "image_file.hpp"
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+// Options after the positional arguments, "--name value" pairs
+static bool parse_options(int argc, char* argv[], int first, std::vector<std::pair<std::string, std::string>>& options)
+{
+    for (int index = first; index < argc; index += 2)
+    {
+        if (index + 1 >= argc || std::string(argv[index]).compare(0, 2, "--") != 0)
+            return false;
+
+        options.emplace_back(argv[index] + 2, argv[index + 1]);
+    }
+
+    return true;
+}
+
+static int record_capture(const std::string& rom_path, const std::string& capture_path, const std::vector<std::pair<std::string, std::string>>& options)
+{
+    uint64_t frames = 600;
+    uint32_t seed = 1;
+    std::string pack_path;
+
+    for (const auto& [name, value] : options)
+    {
+        if (name == "frames")
+            frames = std::strtoull(value.c_str(), nullptr, 0);
+        else if (name == "seed")
+            seed = (uint32_t)std::strtoul(value.c_str(), nullptr, 0);
+        else if (name == "pack")
+            pack_path = value;
+        else
+            return -1;
+    }
+
+    MappedFile rom;
+    if (!rom.open(rom_path) || rom.size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "Cannot open ROM file %s\n", rom_path.c_str());
+        return 1;
+    }
+
+    RomMetadata metadata;
+    if (!resolve_rom_metadata(rom_path, rom.data(), rom.size(), pack_path, metadata))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", pack_path.c_str());
+        return 1;
+    }
+
+    std::unique_ptr<Machine> machine = create_machine(metadata.platform, metadata.quirks);
+    if (!machine->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+    {
+        std::fprintf(stderr, "Cannot load ROM file %s into memory, size is %zu\n", rom_path.c_str(), rom.size());
+        return 1;
+    }
+    machine->seed(seed);
+
+    const int cycles_per_frame = instructions_per_frame(metadata);
+
+    CaptureWriter writer;
+    CaptureEncoder encoder;
+    if (!encoder.open(writer, capture_path, machine->display_width(), machine->display_height(), machine->display_planes()))
+    {
+        std::fprintf(stderr, "Cannot create capture file %s\n", capture_path.c_str());
+        return 1;
+    }
+
+    for (uint64_t frame = 0; frame < frames; frame++)
+    {
+        machine->run(cycles_per_frame);
+        machine->update_timers();
+        encoder.add_frame(machine->get_display(), machine->get_sound_timer(), 0);
+    }
+
+    encoder.close();
+    writer.flush();
+
+    std::printf("Recorded %" PRIu64 " frames, %" PRIu64 " bytes\n", frames, writer.written_bytes());
+
+    return 0;
+}
+
+static int print_info(const std::string& capture_path)
+{
+    CaptureReader reader;
+    if (!reader.open(capture_path))
+    {
+        std::fprintf(stderr, "Cannot open capture file %s\n", capture_path.c_str());
+        return 1;
+    }
+
+    const CaptureHeader& header = reader.header();
+    uint64_t frames = 0;
+    uint64_t changed = 0;
+    uint64_t key_frames = 0;
+    uint64_t gaps = 0;
+    uint64_t sound_frames = 0;
+
+    CaptureReader::Frame frame;
+    while (reader.next_frame(frame))
+    {
+        frames++;
+        changed += (frame.flags & CaptureFlag::DisplayChanged) ? 1 : 0;
+        key_frames += (frame.flags & CaptureFlag::KeyFrame) ? 1 : 0;
+        gaps += (frame.flags & CaptureFlag::Gap) ? 1 : 0;
+        sound_frames += (frame.sound_timer > 0) ? 1 : 0;
+    }
+
+    const double raw_size = (double)frames * header.width * header.height;
+
+    std::printf("%ux%u, %u plane(s), %u fps\n", header.width, header.height, header.planes, header.frames_per_second);
+    std::printf("%" PRIu64 " frames, %" PRIu64 " with display changes, %" PRIu64 " key frames, %" PRIu64 " gaps, %" PRIu64 " with sound\n",
+        frames, changed, key_frames, gaps, sound_frames);
+    std::printf("%zu bytes, %.1fx smaller than raw frames\n", reader.file_size(), (reader.file_size() > 0) ? raw_size / reader.file_size() : 0.0);
+
+    return 0;
+}
+
+// Raw video output, closed on every return. stdout is only flushed.
+struct VideoOutput
+{
+    FILE* file = nullptr;
+
+    ~VideoOutput() { close(); }
+
+    // Returns false when buffered frames could not be written out
+    bool close()
+    {
+        if (!file)
+            return true;
+
+        bool closed = (std::fflush(file) == 0) && !std::ferror(file);
+        if (file != stdout)
+            closed = (std::fclose(file) == 0) && closed;
+
+        file = nullptr;
+        return closed;
+    }
+};
+
+static int export_capture(const std::string& capture_path, const std::string& output, const std::vector<std::pair<std::string, std::string>>& options)
+{
+    std::string format = "png";
+    int scale = 1;
+    uint64_t first = 0;
+    uint64_t count = UINT64_MAX;
+
+    for (const auto& [name, value] : options)
+    {
+        if (name == "format")
+            format = value;
+        else if (name == "scale")
+            scale = std::max(1, std::atoi(value.c_str()));
+        else if (name == "first")
+            first = std::strtoull(value.c_str(), nullptr, 0);
+        else if (name == "count")
+            count = std::strtoull(value.c_str(), nullptr, 0);
+        else
+            return -1;
+    }
+
+    if (format != "png" && format != "pbm" && format != "raw")
+        return -1;
+
+    CaptureReader reader;
+    if (!reader.open(capture_path))
+    {
+        std::fprintf(stderr, "Cannot open capture file %s\n", capture_path.c_str());
+        return 1;
+    }
+
+    const int width = reader.header().width;
+    const int height = reader.header().height;
+
+    VideoOutput video;
+    if (format == "raw")
+    {
+        video.file = (output == "-") ? stdout : std::fopen(output.c_str(), "wb");
+        if (!video.file)
+        {
+            std::fprintf(stderr, "Cannot create %s\n", output.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> rgb;
+    uint64_t exported = 0;
+    CaptureReader::Frame frame;
+
+    while (exported < count && reader.next_frame(frame))
+    {
+        if (frame.index < first)
+            continue;
+
+        bool written = true;
+        if (video.file)
+        {
+            rgb.clear();
+            append_rgb(reader.display(), width, height, scale, rgb);
+            written = std::fwrite(rgb.data(), 1, rgb.size(), video.file) == rgb.size();
+        }
+        else
+        {
+            char suffix[32];
+            std::snprintf(suffix, sizeof(suffix), "_%06" PRIu64 ".%s", frame.index, format.c_str());
+
+            if (format == "png")
+                written = write_png(output + suffix, reader.display(), width, height, scale);
+            else
+                written = write_pbm(output + suffix, reader.display(), width, height, scale);
+        }
+
+        if (!written)
+        {
+            std::fprintf(stderr, "Cannot write frame %" PRIu64 "\n", frame.index);
+            return 1;
+        }
+
+        exported++;
+    }
+
+    if (!video.close())
+    {
+        std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+
+    std::fprintf(stderr, "Exported %" PRIu64 " frames of %dx%d\n", exported, width * scale, height * scale);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string command = (argc > 1) ? argv[1] : "";
+    std::vector<std::pair<std::string, std::string>> options;
+    int result = -1;
+
+    if (command == "record" && argc >= 4 && parse_options(argc, argv, 4, options))
+        result = record_capture(argv[2], argv[3], options);
+    else if (command == "info" && argc == 3)
+        result = print_info(argv[2]);
+    else if (command == "export" && argc >= 4 && parse_options(argc, argv, 4, options))
+        result = export_capture(argv[2], argv[3], options);
+
+    if (result >= 0)
+        return result;
+
+    std::fprintf(stderr,
+        "Usage:\n"
+        "  chip8cap record <rom> <capture> [--frames N] [--pack <file>] [--seed N]\n"
+        "  chip8cap info <capture>\n"
+        "  chip8cap export <capture> <output> [--format png|pbm|raw] [--scale N] [--first N] [--count N]\n");
+
+    return 1;
+}
@@ -0,0 +1,486 @@
+// chip8conf: runs a manifest of test ROMs headlessly and compares their displays against golden hashes
+//
+//   chip8conf run <manifest> [--jobs N] [--static K] [--dump <directory>]
+//   chip8conf record <manifest> [--jobs N] [--static K]
+//
+// Manifest lines are "<rom path> [platform=ch8|sc8|xo8] [quirks=N] [ips=N] [seed=N] [frames=N] [static=K]
+// [input=FRAME:MASK,...] [expect=FRAME:HASH,...]", '#' starts a comment. input holds the hex key mask
+// from FRAME on, expect lists the hex display_hash() after FRAME frames.
+//
+// A ROM stops early once it halts, or once its display stayed the same for K frames (default 120,
+// 0 disables) with no input left; the remaining expectations are then checked against that display.
+// record prints the manifest back with the hashes filled in, at frames=N when a line has no expect.
+// run writes each failing display as <directory>/<line>_<rom>_<frame>.png.
+
+#include "image_file.hpp"
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static inline constexpr auto DefaultStaticFrames = 120;
+static inline constexpr auto DumpScale = 4;
+
+struct InputEvent
+{
+    uint64_t frame = 0;
+    uint16_t keys = 0;
+};
+
+struct Checkpoint
+{
+    uint64_t frame = 0;
+    uint64_t expected = 0;
+    bool has_expected = false;
+    uint64_t actual = 0;
+};
+
+struct TestCase
+{
+    int line_number = 0;
+    std::string path;
+    // The line without its expect option, record appends the new one
+    std::string options;
+    // Trailing comment with the whitespace before it, kept by record
+    std::string comment;
+    RomMetadata metadata;
+    uint32_t seed = 1;
+    uint64_t frames = 0;
+    int static_frames = -1;
+    std::vector<InputEvent> input;
+    std::vector<Checkpoint> checkpoints;
+
+    std::string error;
+    uint64_t frames_run = 0;
+};
+
+struct RunOptions
+{
+    int jobs = 0;
+    int static_frames = DefaultStaticFrames;
+    std::string dump_directory;
+};
+
+static bool parse_number(const std::string& text, uint64_t& value, int base = 0)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, base);
+
+    return *end == 0;
+}
+
+// "FRAME:VALUE,FRAME:VALUE,...", VALUE in hex and optional when allow_missing is set
+template <typename Callback>
+static bool parse_frame_list(const std::string& text, bool allow_missing, Callback callback)
+{
+    std::istringstream stream(text);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        auto colon = item.find(':');
+        uint64_t frame = 0;
+        uint64_t value = 0;
+
+        if (colon == std::string::npos)
+        {
+            if (!allow_missing || !parse_number(item, frame))
+                return false;
+
+            callback(frame, value, false);
+            continue;
+        }
+
+        if (!parse_number(item.substr(0, colon), frame) || !parse_number(item.substr(colon + 1), value, 16))
+            return false;
+
+        callback(frame, value, true);
+    }
+
+    return true;
+}
+
+static bool parse_test_line(const std::string& line, TestCase& test, std::string& error)
+{
+    std::istringstream stream(line);
+    if (!(stream >> test.path))
+        return false;
+
+    test.options = test.path;
+    test.metadata.platform = platform_from_file_name(test.path);
+    bool quirks_set = false;
+
+    std::string option;
+    while (stream >> option)
+    {
+        auto equal = option.find('=');
+        if (equal == std::string::npos)
+            return false;
+
+        std::string key = option.substr(0, equal);
+        std::string value = option.substr(equal + 1);
+        uint64_t number = 0;
+
+        if (key == "expect")
+        {
+            bool valid = parse_frame_list(value, true, [&](uint64_t frame, uint64_t hash, bool has_hash) {
+                test.checkpoints.push_back({ frame, hash, has_hash });
+            });
+
+            if (!valid)
+                return false;
+
+            continue;
+        }
+
+        test.options += " " + option;
+
+        if (key == "platform")
+        {
+            if (!parse_platform(value, test.metadata.platform))
+                return false;
+        }
+        else if (key == "input")
+        {
+            bool valid = parse_frame_list(value, false, [&](uint64_t frame, uint64_t keys, bool) {
+                test.input.push_back({ frame, (uint16_t)keys });
+            });
+
+            if (!valid)
+                return false;
+        }
+        else if (key == "ips")
+        {
+            if (!parse_instructions_per_second(value, test.metadata.instructions_per_second))
+            {
+                error = "invalid ips=" + value + ", expected 1 to " + std::to_string(UINT16_MAX);
+                return false;
+            }
+        }
+        else if (parse_number(value, number))
+        {
+            if (key == "quirks")
+            {
+                test.metadata.quirks = (uint8_t)(number & Quirk::Mask);
+                quirks_set = true;
+            }
+            else if (key == "seed")
+                test.seed = (uint32_t)number;
+            else if (key == "frames")
+                test.frames = number;
+            else if (key == "static")
+                test.static_frames = (int)number;
+            else
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (!quirks_set)
+        test.metadata.quirks = default_quirks(test.metadata.platform);
+
+    auto by_frame = [](const auto& left, const auto& right) { return left.frame < right.frame; };
+    std::stable_sort(test.input.begin(), test.input.end(), by_frame);
+    std::stable_sort(test.checkpoints.begin(), test.checkpoints.end(), by_frame);
+
+    return true;
+}
+
+static std::string dump_path(const RunOptions& options, const TestCase& test, uint64_t frame)
+{
+    std::string name = test.path.substr(test.path.find_last_of("/\\") + 1);
+    name = name.substr(0, name.find_last_of('.'));
+
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "/%d_", test.line_number);
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%06" PRIu64 ".png", frame);
+
+    return options.dump_directory + prefix + name + suffix;
+}
+
+static void check(const RunOptions& options, TestCase& test, Checkpoint& checkpoint, const Machine& machine)
+{
+    checkpoint.actual = machine.display_hash();
+
+    if (!checkpoint.has_expected || checkpoint.actual == checkpoint.expected || options.dump_directory.empty())
+        return;
+
+    write_png(dump_path(options, test, checkpoint.frame), machine.get_display(), machine.display_width(), machine.display_height(), DumpScale);
+}
+
+static void run_test(const RunOptions& options, TestCase& test)
+{
+    MappedFile rom;
+    if (!rom.open(test.path) || rom.size() > UINT32_MAX)
+    {
+        test.error = "cannot open ROM file";
+        return;
+    }
+
+    // Feature::StateHash keeps display_hash() O(1), it is read after every frame
+    std::unique_ptr<Machine> machine = create_machine(test.metadata.platform, test.metadata.quirks, Feature::StateHash);
+    if (!machine->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+    {
+        test.error = "cannot load ROM into memory";
+        return;
+    }
+    machine->seed(test.seed);
+
+    const int cycles_per_frame = instructions_per_frame(test.metadata);
+    const int static_limit = (test.static_frames >= 0) ? test.static_frames : options.static_frames;
+    const uint64_t last_frame = test.checkpoints.empty() ? test.frames : std::max(test.frames, test.checkpoints.back().frame);
+
+    size_t next_input = 0;
+    size_t next_checkpoint = 0;
+    uint16_t keys = 0;
+    int static_frames = 0;
+    uint64_t frame = 0;
+
+    for (;;)
+    {
+        while (next_checkpoint < test.checkpoints.size() && test.checkpoints[next_checkpoint].frame <= frame)
+            check(options, test, test.checkpoints[next_checkpoint++], *machine);
+
+        if (frame >= last_frame || next_checkpoint == test.checkpoints.size())
+            break;
+
+        // Nothing can change the display anymore, at least not without more input
+        const bool idle = static_limit > 0 && static_frames >= static_limit && next_input == test.input.size();
+        if (idle || machine->halted())
+            break;
+
+        while (next_input < test.input.size() && test.input[next_input].frame <= frame)
+            keys = test.input[next_input++].keys;
+
+        const uint64_t hash = machine->display_hash();
+        machine->set_keys(keys);
+        machine->run(cycles_per_frame);
+        machine->update_timers();
+        frame++;
+
+        static_frames = (machine->display_hash() == hash) ? static_frames + 1 : 0;
+    }
+
+    while (next_checkpoint < test.checkpoints.size())
+        check(options, test, test.checkpoints[next_checkpoint++], *machine);
+
+    test.frames_run = frame;
+}
+
+static void run_all(const RunOptions& options, std::vector<TestCase>& tests)
+{
+    const int jobs = std::max(1, (options.jobs > 0) ? options.jobs : (int)std::thread::hardware_concurrency());
+    std::atomic<size_t> next_test { 0 };
+    std::vector<std::thread> workers;
+
+    for (int index = 0; index < jobs; index++)
+    {
+        workers.emplace_back([&] {
+            for (size_t test = next_test++; test < tests.size(); test = next_test++)
+                run_test(options, tests[test]);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+static bool parse_options(int argc, char* argv[], int first, RunOptions& options)
+{
+    for (int index = first; index < argc; index += 2)
+    {
+        if (index + 1 >= argc)
+            return false;
+
+        std::string argument = argv[index];
+        std::string value = argv[index + 1];
+        uint64_t number = 0;
+
+        if (argument == "--dump")
+            options.dump_directory = value;
+        else if (argument == "--jobs" && parse_number(value, number))
+            options.jobs = (int)number;
+        else if (argument == "--static" && parse_number(value, number))
+            options.static_frames = (int)number;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+static bool read_manifest(const std::string& manifest_path, std::vector<std::string>& lines, std::vector<TestCase>& tests)
+{
+    std::ifstream manifest(manifest_path);
+    if (!manifest.is_open())
+    {
+        std::fprintf(stderr, "Cannot open manifest %s\n", manifest_path.c_str());
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        lines.push_back(line);
+
+        std::string comment;
+        auto comment_start = line.find('#');
+        if (comment_start != std::string::npos)
+        {
+            while (comment_start > 0 && (line[comment_start - 1] == ' ' || line[comment_start - 1] == '\t'))
+                comment_start--;
+
+            comment = line.substr(comment_start);
+            line.erase(comment_start);
+        }
+
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        TestCase test;
+        test.line_number = (int)lines.size();
+        test.comment = comment;
+        std::string error = "invalid manifest line";
+        if (!parse_test_line(line, test, error))
+        {
+            std::fprintf(stderr, "%s:%d: %s\n", manifest_path.c_str(), test.line_number, error.c_str());
+            return false;
+        }
+
+        tests.push_back(std::move(test));
+    }
+
+    return true;
+}
+
+static int run_manifest(const std::string& manifest_path, const RunOptions& options)
+{
+    std::vector<std::string> lines;
+    std::vector<TestCase> tests;
+    if (!read_manifest(manifest_path, lines, tests))
+        return 1;
+
+    const auto start = std::chrono::steady_clock::now();
+    run_all(options, tests);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    int failed = 0;
+    uint64_t frames = 0;
+
+    for (const TestCase& test : tests)
+    {
+        frames += test.frames_run;
+
+        if (!test.error.empty())
+        {
+            std::printf("FAIL %s:%d %s: %s\n", manifest_path.c_str(), test.line_number, test.path.c_str(), test.error.c_str());
+            failed++;
+            continue;
+        }
+
+        bool passed = true;
+        for (const Checkpoint& checkpoint : test.checkpoints)
+        {
+            if (!checkpoint.has_expected)
+            {
+                std::printf("FAIL %s:%d %s: frame %" PRIu64 " has no expected hash, got %016" PRIx64 "\n",
+                    manifest_path.c_str(), test.line_number, test.path.c_str(), checkpoint.frame, checkpoint.actual);
+                passed = false;
+            }
+            else if (checkpoint.actual != checkpoint.expected)
+            {
+                std::printf("FAIL %s:%d %s: frame %" PRIu64 " expected %016" PRIx64 ", got %016" PRIx64 "\n",
+                    manifest_path.c_str(), test.line_number, test.path.c_str(), checkpoint.frame, checkpoint.expected, checkpoint.actual);
+                passed = false;
+            }
+        }
+
+        failed += passed ? 0 : 1;
+    }
+
+    std::printf("%d passed, %d failed, %" PRIu64 " frames in %.2f s\n", (int)tests.size() - failed, failed, frames, elapsed.count());
+
+    return (failed == 0) ? 0 : 1;
+}
+
+static int record_manifest(const std::string& manifest_path, const RunOptions& options)
+{
+    std::vector<std::string> lines;
+    std::vector<TestCase> tests;
+    if (!read_manifest(manifest_path, lines, tests))
+        return 1;
+
+    for (TestCase& test : tests)
+    {
+        if (test.checkpoints.empty() && test.frames > 0)
+            test.checkpoints.push_back({ test.frames });
+    }
+
+    run_all(options, tests);
+
+    size_t next_test = 0;
+    int errors = 0;
+
+    for (size_t index = 0; index < lines.size(); index++)
+    {
+        if (next_test >= tests.size() || tests[next_test].line_number != (int)index + 1)
+        {
+            std::printf("%s\n", lines[index].c_str());
+            continue;
+        }
+
+        const TestCase& test = tests[next_test++];
+        if (!test.error.empty() || test.checkpoints.empty())
+        {
+            std::fprintf(stderr, "%s:%d %s: %s\n", manifest_path.c_str(), test.line_number, test.path.c_str(),
+                test.error.empty() ? "needs frames=N or expect=FRAME" : test.error.c_str());
+            std::printf("%s\n", lines[index].c_str());
+            errors++;
+            continue;
+        }
+
+        std::printf("%s expect=", test.options.c_str());
+        for (size_t checkpoint = 0; checkpoint < test.checkpoints.size(); checkpoint++)
+            std::printf("%s%" PRIu64 ":%016" PRIx64, checkpoint ? "," : "", test.checkpoints[checkpoint].frame, test.checkpoints[checkpoint].actual);
+        std::printf("%s\n", test.comment.c_str());
+    }
+
+    return (errors == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string command = (argc > 1) ? argv[1] : "";
+    RunOptions options;
+
+    if (command == "run" && argc >= 3 && parse_options(argc, argv, 3, options))
+        return run_manifest(argv[2], options);
+
+    if (command == "record" && argc >= 3 && parse_options(argc, argv, 3, options) && options.dump_directory.empty())
+        return record_manifest(argv[2], options);
+
+    std::fprintf(stderr,
+        "Usage:\n"
+        "  chip8conf run <manifest> [--jobs N] [--static K] [--dump <directory>]\n"
+        "  chip8conf record <manifest> [--jobs N] [--static K]\n");
+
+    return 1;
+}
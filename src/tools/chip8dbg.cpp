@@ -0,0 +1,631 @@
+// chip8dbg: command line debugger
+//
+//   chip8dbg [--pack <file>] [--ips N] [--seed N] <rom>
+//
+// Runs the ROM on a core instantiated with Feature::Debugger, production cores are
+// compiled without any of the hooks. Type "help" at the prompt for the commands,
+// Ctrl+C interrupts a running "continue".
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include "mapped_file.hpp"
+#include "ram_search.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static inline constexpr auto SearchListLimit = 32;
+
+static Debugger* g_debugger = nullptr;
+
+static void interrupt_handler(int)
+{
+    if (g_debugger)
+        g_debugger->interrupt();
+
+    std::signal(SIGINT, interrupt_handler);
+}
+
+struct DebuggerOptions
+{
+    std::string pack_path;
+    std::string rom_path;
+    int instructions_per_second = 0;
+    uint32_t seed = 1;
+};
+
+static bool parse_number(const std::string& text, uint32_t& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    value = (uint32_t)std::strtoul(text.c_str(), &end, 0);
+
+    return *end == 0;
+}
+
+static bool parse_search_compare(const std::string& text, RamCompare& compare)
+{
+    static const struct
+    {
+        const char* name;
+        RamCompare compare;
+    } compares[] = {
+        { "eq", RamCompare::Equal }, { "ne", RamCompare::NotEqual }, { "lt", RamCompare::Less },
+        { "gt", RamCompare::Greater }, { "same", RamCompare::Unchanged }, { "changed", RamCompare::Changed },
+        { "inc", RamCompare::Increased }, { "dec", RamCompare::Decreased }, { "by", RamCompare::ChangedBy },
+    };
+
+    for (const auto& candidate : compares)
+    {
+        if (text == candidate.name)
+        {
+            compare = candidate.compare;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Platform>
+class DebugSession
+{
+public:
+    using Core = CHIP8<Platform, Feature::Debugger>;
+
+    DebugSession(const MappedFile& rom, const DebuggerOptions& options, int cycles_per_frame)
+        : m_core(std::make_unique<Core>())
+        , m_rom(rom)
+        , m_options(options)
+        , m_cycles_per_frame(cycles_per_frame)
+    {
+    }
+
+    bool init()
+    {
+        m_core->attach_debugger(&m_debugger);
+        if (!reset())
+            return false;
+
+        g_debugger = &m_debugger;
+        std::signal(SIGINT, interrupt_handler);
+
+        return true;
+    }
+
+    int run()
+    {
+        print_location();
+
+        std::string line;
+        std::string last_line;
+
+        while (true)
+        {
+            std::printf("(chip8) ");
+            std::fflush(stdout);
+
+            if (!std::getline(std::cin, line))
+                break;
+
+            // An empty line repeats the previous command, handy for stepping
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                line = last_line;
+            else
+                last_line = line;
+
+            if (!execute_command(line))
+                break;
+        }
+
+        g_debugger = nullptr;
+
+        return 0;
+    }
+
+private:
+    std::unique_ptr<Core> m_core;
+    Debugger m_debugger;
+    const MappedFile& m_rom;
+    DebuggerOptions m_options;
+    int m_cycles_per_frame = 0;
+    int m_frame_cycle = 0;
+    uint64_t m_frame = 0;
+    uint16_t m_keys = 0;
+
+    RamSearch m_search;
+    std::vector<uint8_t> m_search_snapshot;
+
+    bool reset()
+    {
+        if (!m_core->load_rom_in_memory(reinterpret_cast<const char*>(m_rom.data()), (uint32_t)m_rom.size()))
+        {
+            std::fprintf(stderr, "Cannot load ROM file %s into memory, size is %zu\n", m_options.rom_path.c_str(), m_rom.size());
+            return false;
+        }
+
+        m_core->seed(m_options.seed);
+        m_core->set_keys(m_keys);
+        m_frame_cycle = 0;
+        m_frame = 0;
+        m_debugger.resume(m_core->get_registers().PC);
+        m_debugger.reset_call_depth(m_core->get_registers().SP);
+        start_search();
+
+        return true;
+    }
+
+    uint8_t peek(uint32_t address) const { return m_core->get_memory()[address & Core::AddressMask]; }
+    uint16_t peek_word(uint32_t address) const { return (uint16_t)(peek(address) << 8 | peek(address + 1)); }
+
+    uint16_t current_opcode() const { return peek_word(m_core->get_registers().PC); }
+
+    int print_instruction(uint32_t address) const
+    {
+        std::string text;
+        const int length = disassemble(peek_word(address), peek_word(address + 2), Platform::Flags, text);
+
+        std::printf("%c %03X: %04X  %s\n", m_debugger.has_breakpoint((uint16_t)address) ? '*' : ' ', address, peek_word(address), text.c_str());
+
+        return length;
+    }
+
+    void print_location() const
+    {
+        if (m_core->halted())
+            std::printf("Halted\n");
+
+        print_instruction(m_core->get_registers().PC);
+    }
+
+    void print_stop() const
+    {
+        switch (m_debugger.stop_reason())
+        {
+        case DebugStop::Breakpoint:
+            std::printf("Breakpoint at %03X\n", m_debugger.stop_address());
+            break;
+
+        case DebugStop::Condition:
+            std::printf("Condition hit after the instruction before %03X\n", m_debugger.stop_address());
+            break;
+
+        case DebugStop::ReadWatch:
+            std::printf("Read watchpoint %03X = %02X\n", m_debugger.stop_address(), m_debugger.stop_value());
+            break;
+
+        case DebugStop::WriteWatch:
+            std::printf("Write watchpoint %03X = %02X\n", m_debugger.stop_address(), m_debugger.stop_value());
+            break;
+
+        case DebugStop::Interrupt:
+            std::printf("Interrupted\n");
+            break;
+
+        default:
+            break;
+        }
+
+        print_location();
+    }
+
+    // Runs until the debugger stops, the core halts or max_frames frames went by
+    void run_until_stop(uint64_t max_frames)
+    {
+        const uint64_t last_frame = (max_frames == 0) ? UINT64_MAX : m_frame + max_frames;
+
+        while (!m_debugger.stopped() && !m_core->halted() && m_frame < last_frame)
+        {
+            const uint64_t before = m_debugger.instructions();
+            m_core->run(m_cycles_per_frame - m_frame_cycle);
+            m_frame_cycle += (int)(m_debugger.instructions() - before);
+
+            if (m_frame_cycle >= m_cycles_per_frame)
+            {
+                m_core->update_timers();
+                m_frame_cycle = 0;
+                m_frame++;
+            }
+        }
+
+        print_stop();
+    }
+
+    void step_instruction()
+    {
+        const uint64_t before = m_debugger.instructions();
+        m_core->execute();
+
+        if (m_debugger.instructions() != before && ++m_frame_cycle >= m_cycles_per_frame)
+        {
+            m_core->update_timers();
+            m_frame_cycle = 0;
+            m_frame++;
+        }
+    }
+
+    void print_registers() const
+    {
+        const auto& registers = m_core->get_registers();
+
+        for (int index = 0; index < 16; index++)
+            std::printf("V%X=%02X%s", index, registers.V[index], (index == 7 || index == 15) ? "\n" : " ");
+
+        std::printf("PC=%03X I=%03X SP=%X DT=%02X ST=%02X keys=%04X frame=%llu\n", registers.PC, registers.I, registers.SP,
+            m_core->get_delay_timer(), m_core->get_sound_timer(), m_keys, (unsigned long long)m_frame);
+    }
+
+    void print_stack() const
+    {
+        const auto& registers = m_core->get_registers();
+        const uint16_t* stack = m_core->get_stack();
+
+        // SP wraps after 16 nested calls, only the 16 most recent return addresses are left
+        const int64_t depth = std::max<int64_t>(m_debugger.call_depth(), 0);
+        const int levels = (int)std::min<int64_t>(depth, CHIP8Base::StackSize);
+
+        std::printf("#0 %03X\n", registers.PC);
+        for (int level = 0; level < levels; level++)
+            std::printf("#%d %03X\n", level + 1, stack[(registers.SP - 1 - level) & CHIP8Base::StackMask]);
+
+        if (depth > levels)
+            std::printf("... %lld older calls overwritten, the stack holds %d\n", (long long)(depth - levels), CHIP8Base::StackSize);
+    }
+
+    void print_memory(uint32_t address, uint32_t length) const
+    {
+        for (uint32_t offset = 0; offset < length; offset += 16)
+        {
+            std::printf("%04X:", (address + offset) & Core::AddressMask);
+            for (uint32_t index = offset; index < std::min(length, offset + 16); index++)
+                std::printf(" %02X", peek(address + index));
+            std::printf("\n");
+        }
+    }
+
+    void print_screen() const
+    {
+        const uint8_t* display = m_core->get_display();
+
+        // Two display rows per text line
+        for (int y = 0; y < Core::DisplayHeight; y += 2)
+        {
+            std::string line;
+            for (int x = 0; x < Core::DisplayWidth; x++)
+            {
+                const bool top = display[y * Core::DisplayWidth + x] != 0;
+                const bool bottom = display[(y + 1) * Core::DisplayWidth + x] != 0;
+                line += top ? (bottom ? '#' : '"') : (bottom ? '.' : ' ');
+            }
+            std::printf("|%s|\n", line.c_str());
+        }
+    }
+
+    void print_breakpoints() const
+    {
+        for (const auto& breakpoint : m_debugger.breakpoints())
+        {
+            if (breakpoint.conditional)
+                std::printf("break %03X if %s\n", breakpoint.address, breakpoint.condition.to_string().c_str());
+            else
+                std::printf("break %03X\n", breakpoint.address);
+        }
+
+        for (const auto& watchpoint : m_debugger.watchpoints())
+        {
+            const char* kind = (watchpoint.read && watchpoint.write) ? "awatch" : (watchpoint.read ? "rwatch" : "watch");
+            std::printf("%s %03X %u\n", kind, watchpoint.address, watchpoint.length);
+        }
+
+        for (const auto& condition : m_debugger.conditions())
+            std::printf("cond %s\n", condition.to_string().c_str());
+    }
+
+    void start_search()
+    {
+        m_search.reset(Core::MemorySize);
+        m_search_snapshot.assign(m_core->get_memory(), m_core->get_memory() + Core::MemorySize);
+    }
+
+    void search(std::istringstream& arguments)
+    {
+        std::string operation;
+        arguments >> operation;
+
+        if (operation == "reset")
+        {
+            start_search();
+        }
+        else if (operation == "list")
+        {
+            for (uint32_t address : m_search.addresses(SearchListLimit))
+                std::printf("%04X = %02X (was %02X)\n", address, peek(address), m_search_snapshot[address]);
+        }
+        else if (operation == "watch")
+        {
+            // Candidates feed straight into write watchpoints
+            m_search.for_each_candidate([&](uint32_t address) { m_debugger.set_watchpoint((uint16_t)address, 1, false, true); });
+        }
+        else
+        {
+            RamCompare compare;
+            std::string value_text;
+            uint32_t value = 0;
+
+            if (!parse_search_compare(operation, compare) || ((arguments >> value_text) && !parse_number(value_text, value)))
+            {
+                std::printf("Usage: search reset | list | watch | eq|ne|lt|gt|by N | same|changed|inc|dec\n");
+                return;
+            }
+
+            m_search.filter(m_core->get_memory(), m_search_snapshot.data(), compare, (uint8_t)value);
+            m_search_snapshot.assign(m_core->get_memory(), m_core->get_memory() + Core::MemorySize);
+        }
+
+        std::printf("%u candidates\n", m_search.count());
+    }
+
+    bool execute_command(const std::string& line)
+    {
+        std::istringstream arguments(line);
+        std::string command;
+        arguments >> command;
+
+        std::string first;
+        std::string second;
+        uint32_t number = 0;
+        uint32_t count = 0;
+
+        if (command == "q" || command == "quit")
+        {
+            return false;
+        }
+        else if (command == "c" || command == "continue")
+        {
+            arguments >> first;
+            m_debugger.resume(m_core->get_registers().PC);
+            run_until_stop(parse_number(first, number) ? number : 0);
+        }
+        else if (command == "s" || command == "step")
+        {
+            arguments >> first;
+            count = parse_number(first, number) ? std::max(1u, number) : 1;
+
+            for (uint32_t index = 0; index < count && !m_core->halted(); index++)
+            {
+                m_debugger.step(m_core->get_registers().PC);
+                step_instruction();
+
+                if (m_debugger.stop_reason() != DebugStop::Step)
+                    break;
+            }
+
+            if (m_debugger.stop_reason() != DebugStop::Step)
+                print_stop();
+            else
+                print_location();
+        }
+        else if (command == "n" || command == "next")
+        {
+            m_debugger.step_over(m_core->get_registers(), current_opcode());
+            if ((current_opcode() & 0xF000) == 0x2000)
+            {
+                run_until_stop(0);
+            }
+            else
+            {
+                step_instruction();
+
+                if (m_debugger.stop_reason() != DebugStop::Step)
+                    print_stop();
+                else
+                    print_location();
+            }
+        }
+        else if (command == "b" || command == "break")
+        {
+            arguments >> first >> second;
+            if (!parse_number(first, number))
+            {
+                std::printf("Usage: break <address> [if <condition>]\n");
+            }
+            else if (second == "if")
+            {
+                std::string text;
+                std::getline(arguments, text);
+
+                DebugCondition condition;
+                if (DebugCondition::parse(text, condition))
+                    m_debugger.set_breakpoint((uint16_t)number, condition);
+                else
+                    std::printf("Invalid condition, expected e.g. \"v3 == 5\" or \"i >= 0x300\"\n");
+            }
+            else
+            {
+                m_debugger.set_breakpoint((uint16_t)number);
+            }
+        }
+        else if (command == "d" || command == "delete")
+        {
+            if (!(arguments >> first))
+                m_debugger.clear_all();
+            else if (!parse_number(first, number) || !m_debugger.clear_breakpoint((uint16_t)number))
+                std::printf("No breakpoint at %s\n", first.c_str());
+        }
+        else if (command == "watch" || command == "rwatch" || command == "awatch")
+        {
+            arguments >> first >> second;
+            if (!parse_number(first, number))
+                std::printf("Usage: %s <address> [length]\n", command.c_str());
+            else
+                m_debugger.set_watchpoint((uint16_t)number, parse_number(second, count) ? count : 1, command != "watch", command != "rwatch");
+        }
+        else if (command == "unwatch")
+        {
+            arguments >> first >> second;
+            if (!parse_number(first, number))
+                std::printf("Usage: unwatch <address> [length]\n");
+            else
+                m_debugger.clear_watchpoint((uint16_t)number, parse_number(second, count) ? count : 1);
+        }
+        else if (command == "cond")
+        {
+            std::string text;
+            std::getline(arguments, text);
+
+            DebugCondition condition;
+            if (DebugCondition::parse(text, condition))
+                m_debugger.add_condition(condition);
+            else
+                std::printf("Invalid condition, expected e.g. \"v3 == 5\" or \"i >= 0x300\"\n");
+        }
+        else if (command == "i" || command == "info")
+        {
+            print_breakpoints();
+        }
+        else if (command == "r" || command == "regs")
+        {
+            print_registers();
+        }
+        else if (command == "bt" || command == "stack")
+        {
+            print_stack();
+        }
+        else if (command == "x")
+        {
+            arguments >> first >> second;
+            if (!parse_number(first, number))
+                std::printf("Usage: x <address> [length]\n");
+            else
+                print_memory(number, parse_number(second, count) ? count : 16);
+        }
+        else if (command == "l" || command == "dis")
+        {
+            arguments >> first >> second;
+            uint32_t address = parse_number(first, number) ? number : m_core->get_registers().PC;
+            count = parse_number(second, count) ? count : 10;
+
+            for (uint32_t index = 0; index < count; index++)
+                address += print_instruction(address & Core::AddressMask);
+        }
+        else if (command == "screen")
+        {
+            print_screen();
+        }
+        else if (command == "keys")
+        {
+            arguments >> first;
+            if (parse_number(first, number))
+            {
+                m_keys = (uint16_t)number;
+                m_core->set_keys(m_keys);
+            }
+            std::printf("keys=%04X\n", m_keys);
+        }
+        else if (command == "search")
+        {
+            search(arguments);
+        }
+        else if (command == "reset")
+        {
+            if (reset())
+                print_location();
+        }
+        else if (command == "h" || command == "help")
+        {
+            std::printf(
+                "continue|c [frames]        run until a stop, at most frames frames\n"
+                "step|s [count]             execute instructions\n"
+                "next|n                     step over a CALL\n"
+                "break|b <addr> [if <cond>] break before the instruction at addr\n"
+                "delete|d [addr]            delete a breakpoint, or everything\n"
+                "watch|rwatch|awatch <addr> [length]  stop after a write, read or any access\n"
+                "unwatch <addr> [length]    remove watchpoints\n"
+                "cond <cond>                stop when a condition becomes true\n"
+                "info|i                     list breakpoints, watchpoints and conditions\n"
+                "regs|r  stack|bt  screen   show the machine state\n"
+                "x <addr> [length]          dump memory\n"
+                "dis|l [addr] [count]       disassemble\n"
+                "keys <mask>                set the pressed keys, bit N is key N\n"
+                "search ...                 RAM search: reset, list, watch, eq|ne|lt|gt|by N, same|changed|inc|dec\n"
+                "reset  quit|q\n"
+                "Conditions compare V0-VF or I with a number: \"v3 == 5\", \"i >= 0x300\"\n");
+        }
+        else
+        {
+            std::printf("Unknown command \"%s\", try help\n", command.c_str());
+        }
+
+        return true;
+    }
+};
+
+static bool parse_options(int argc, char* argv[], DebuggerOptions& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        bool has_value = (index + 1) < argc;
+
+        if (argument == "--pack" && has_value)
+            options.pack_path = argv[++index];
+        else if (argument == "--ips" && has_value)
+            options.instructions_per_second = std::atoi(argv[++index]);
+        else if (argument == "--seed" && has_value)
+            options.seed = (uint32_t)std::strtoul(argv[++index], nullptr, 0);
+        else if (options.rom_path.empty())
+            options.rom_path = argument;
+        else
+            return false;
+    }
+
+    return !options.rom_path.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    DebuggerOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: chip8dbg [--pack <file>] [--ips N] [--seed N] <rom>\n");
+        return 1;
+    }
+
+    MappedFile rom;
+    if (!rom.open(options.rom_path) || rom.size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "Cannot open ROM file %s\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    RomMetadata metadata;
+    if (!resolve_rom_metadata(options.rom_path, rom.data(), rom.size(), options.pack_path, metadata))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", options.pack_path.c_str());
+        return 1;
+    }
+
+    const int cycles_per_frame = instructions_per_frame(metadata, options.instructions_per_second);
+
+    std::printf("%s (%s, quirks 0x%X, %d instructions per frame)\n", options.rom_path.c_str(), platform_name(metadata.platform), metadata.quirks, cycles_per_frame);
+
+    return dispatch_platform(metadata.platform, metadata.quirks, [&](auto platform) {
+        using Platform = typename decltype(platform)::type;
+
+        DebugSession<Platform> session(rom, options, cycles_per_frame);
+        if (!session.init())
+            return 1;
+
+        return session.run();
+    });
+}
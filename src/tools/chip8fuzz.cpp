@@ -0,0 +1,277 @@
+// chip8fuzz: fuzzing harness for the core
+//
+//   chip8fuzz [--runs N] [--seed N] [--max-size N] [--verify-hash] [input file or directory...]
+//
+// Compiled with CHIP8_LIBFUZZER defined (the CHIP8_FUZZER CMake option) this is a libFuzzer
+// target. Otherwise this standalone driver replays the given inputs, or runs N random ones
+// when there are none, then prints the executions per second and the hits per opcode handler.
+// Build with -fsanitize=address,undefined to catch out of bounds accesses. --verify-hash (or
+// CHIP8_FUZZ_VERIFY_HASH=1 for the libFuzzer target) runs cores built with
+// Feature::VerifyStateHash, which abort when the incremental state hash disagrees with a full
+// recompute after any instruction.
+//
+// Input layout: byte 0 selects the platform (bits 0-1) and the quirks (bits 2-5), bytes 1-2
+// are the key mask, the rest is the ROM.
+
+#include "chip8.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static inline constexpr auto FramesPerInput = 4;
+static inline constexpr auto CyclesPerFrame = 256;
+static inline constexpr auto InputHeaderSize = 3;
+
+struct OpcodeHandler
+{
+    uint16_t mask;
+    uint16_t value;
+    const char* name;
+};
+
+// First match wins, the catch-all entries of each group are encodings no handler accepts
+static const OpcodeHandler OpcodeHandlers[] = {
+    { 0xFFFF, 0x00E0, "00E0" }, { 0xFFFF, 0x00EE, "00EE" }, { 0xFFFF, 0x00FB, "00FB" }, { 0xFFFF, 0x00FC, "00FC" },
+    { 0xFFFF, 0x00FD, "00FD" }, { 0xFFFF, 0x00FE, "00FE" }, { 0xFFFF, 0x00FF, "00FF" }, { 0xFFF0, 0x00C0, "00CN" },
+    { 0xFFF0, 0x00D0, "00DN" }, { 0xF000, 0x0000, "0NNN" },
+    { 0xF000, 0x1000, "1NNN" }, { 0xF000, 0x2000, "2NNN" }, { 0xF000, 0x3000, "3XKK" }, { 0xF000, 0x4000, "4XKK" },
+    { 0xF00F, 0x5000, "5XY0" }, { 0xF00F, 0x5002, "5XY2" }, { 0xF00F, 0x5003, "5XY3" }, { 0xF000, 0x5000, "5XYN" },
+    { 0xF000, 0x6000, "6XKK" }, { 0xF000, 0x7000, "7XKK" },
+    { 0xF00F, 0x8000, "8XY0" }, { 0xF00F, 0x8001, "8XY1" }, { 0xF00F, 0x8002, "8XY2" }, { 0xF00F, 0x8003, "8XY3" },
+    { 0xF00F, 0x8004, "8XY4" }, { 0xF00F, 0x8005, "8XY5" }, { 0xF00F, 0x8006, "8XY6" }, { 0xF00F, 0x8007, "8XY7" },
+    { 0xF00F, 0x800E, "8XYE" }, { 0xF000, 0x8000, "8XYN" },
+    { 0xF000, 0x9000, "9XY0" }, { 0xF000, 0xA000, "ANNN" }, { 0xF000, 0xB000, "BNNN" }, { 0xF000, 0xC000, "CXKK" },
+    { 0xF000, 0xD000, "DXYN" }, { 0xF0FF, 0xE09E, "EX9E" }, { 0xF0FF, 0xE0A1, "EXA1" }, { 0xF000, 0xE000, "EXKK" },
+    { 0xFFFF, 0xF000, "F000" }, { 0xF0FF, 0xF001, "FX01" }, { 0xF0FF, 0xF002, "FX02" }, { 0xF0FF, 0xF007, "FX07" },
+    { 0xF0FF, 0xF00A, "FX0A" }, { 0xF0FF, 0xF015, "FX15" }, { 0xF0FF, 0xF018, "FX18" }, { 0xF0FF, 0xF01E, "FX1E" },
+    { 0xF0FF, 0xF029, "FX29" }, { 0xF0FF, 0xF030, "FX30" }, { 0xF0FF, 0xF033, "FX33" }, { 0xF0FF, 0xF03A, "FX3A" },
+    { 0xF0FF, 0xF055, "FX55" }, { 0xF0FF, 0xF065, "FX65" }, { 0xF0FF, 0xF075, "FX75" }, { 0xF0FF, 0xF085, "FX85" },
+    { 0xF000, 0xF000, "FXKK" },
+};
+
+static inline constexpr auto OpcodeHandlerCount = sizeof(OpcodeHandlers) / sizeof(OpcodeHandlers[0]);
+
+static uint64_t g_handler_hits[OpcodeHandlerCount] = { 0 };
+static bool g_verify_hash = false;
+
+static uint8_t opcode_handler(uint16_t opcode)
+{
+    static const auto table = [] {
+        std::array<uint8_t, 0x10000> result {};
+        for (uint32_t value = 0; value < 0x10000; value++)
+        {
+            for (uint8_t index = 0; index < OpcodeHandlerCount; index++)
+            {
+                if ((value & OpcodeHandlers[index].mask) == OpcodeHandlers[index].value)
+                {
+                    result[value] = index;
+                    break;
+                }
+            }
+        }
+        return result;
+    }();
+
+    return table[opcode];
+}
+
+template <typename Platform, uint32_t Features>
+class FuzzTarget
+{
+public:
+    using Core = CHIP8<Platform, Features>;
+
+    static FuzzTarget& instance()
+    {
+        static FuzzTarget target;
+        return target;
+    }
+
+    void run(uint16_t keys, const uint8_t* rom, size_t size)
+    {
+        // The core is trivially copyable, restoring the pristine snapshot is one memcpy
+        // instead of clearing memory and reloading the fonts for every input
+        std::memcpy(static_cast<void*>(m_core.get()), m_pristine.get(), sizeof(Core));
+        if (size > UINT32_MAX || !m_core->write_memory(CHIP8Base::ResetVector, rom, (uint32_t)size))
+            return;
+
+        m_core->set_keys(keys);
+
+        for (int frame = 0; frame < FramesPerInput && !m_core->halted(); frame++)
+        {
+            for (int cycle = 0; cycle < CyclesPerFrame; cycle++)
+            {
+                const uint8_t* memory = m_core->get_memory();
+                const uint16_t pc = m_core->get_registers().PC;
+                const uint16_t opcode = memory[pc & Core::AddressMask] << 8 | memory[(pc + 1) & Core::AddressMask];
+                g_handler_hits[opcode_handler(opcode)]++;
+
+                m_core->execute();
+
+                // A jump to itself or a key wait that can never finish will not reach anything
+                // new, neither will sliding through zeroed memory past the end of the ROM
+                if (m_core->get_registers().PC == pc || opcode == 0x0000)
+                    return;
+            }
+
+            m_core->update_timers();
+        }
+    }
+
+private:
+    std::unique_ptr<Core> m_pristine = std::make_unique<Core>();
+    std::unique_ptr<Core> m_core = std::make_unique<Core>();
+
+    FuzzTarget() { m_pristine->load_rom_in_memory(nullptr, 0); }
+};
+
+static void run_input(const uint8_t* data, size_t size)
+{
+    if (size < InputHeaderSize)
+        return;
+
+    const PlatformType platform = (PlatformType)std::min<int>(data[0] & 3, (int)PlatformType::XOChip);
+    const uint8_t quirks = (data[0] >> 2) & Quirk::Mask;
+    const uint16_t keys = (uint16_t)(data[1] | (data[2] << 8));
+
+    dispatch_platform(platform, quirks, [&](auto tag) {
+        using Platform = typename decltype(tag)::type;
+        if (g_verify_hash)
+            FuzzTarget<Platform, Feature::VerifyStateHash>::instance().run(keys, data + InputHeaderSize, size - InputHeaderSize);
+        else
+            FuzzTarget<Platform, 0>::instance().run(keys, data + InputHeaderSize, size - InputHeaderSize);
+    });
+}
+
+static void print_coverage()
+{
+    int reached = 0;
+    for (size_t index = 0; index < OpcodeHandlerCount; index++)
+    {
+        std::fprintf(stderr, "%s %12" PRIu64 "%s", OpcodeHandlers[index].name, g_handler_hits[index], ((index % 4) == 3) ? "\n" : "    ");
+        reached += (g_handler_hits[index] > 0) ? 1 : 0;
+    }
+
+    std::fprintf(stderr, "%s%d of %zu opcode handlers reached\n", ((OpcodeHandlerCount % 4) != 0) ? "\n" : "", reached, OpcodeHandlerCount);
+}
+
+#ifdef CHIP8_LIBFUZZER
+
+extern "C" int LLVMFuzzerInitialize(int*, char***)
+{
+    const char* verify_hash = std::getenv("CHIP8_FUZZ_VERIFY_HASH");
+    g_verify_hash = verify_hash && std::strcmp(verify_hash, "0") != 0;
+    std::atexit(print_coverage);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    run_input(data, size);
+    return 0;
+}
+
+#else
+
+static bool run_file(const std::string& path, uint64_t& executions)
+{
+    MappedFile input;
+    if (!input.open(path))
+    {
+        std::fprintf(stderr, "Cannot open input %s\n", path.c_str());
+        return false;
+    }
+
+    run_input(input.data(), input.size());
+    executions++;
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t runs = 100000;
+    uint32_t seed = 1;
+    size_t max_size = 4096;
+    std::vector<std::string> inputs;
+
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        if (argument == "--runs" && index + 1 < argc)
+            runs = std::strtoull(argv[++index], nullptr, 0);
+        else if (argument == "--seed" && index + 1 < argc)
+            seed = (uint32_t)std::strtoul(argv[++index], nullptr, 0);
+        else if (argument == "--max-size" && index + 1 < argc)
+            max_size = std::max<size_t>(InputHeaderSize, std::strtoull(argv[++index], nullptr, 0));
+        else if (argument == "--verify-hash")
+            g_verify_hash = true;
+        else if (argument.compare(0, 2, "--") != 0)
+            inputs.push_back(argument);
+        else
+        {
+            std::fprintf(stderr, "Usage: chip8fuzz [--runs N] [--seed N] [--max-size N] [--verify-hash] [input file or directory...]\n");
+            return 1;
+        }
+    }
+
+    uint64_t executions = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    if (inputs.empty())
+    {
+        std::mt19937 random(seed);
+        std::vector<uint8_t> input;
+
+        for (uint64_t run = 0; run < runs; run++)
+        {
+            input.resize(InputHeaderSize + (random() % (max_size - InputHeaderSize + 1)));
+            for (size_t offset = 0; offset < input.size(); offset += 4)
+            {
+                const uint32_t value = random();
+                std::memcpy(input.data() + offset, &value, std::min<size_t>(4, input.size() - offset));
+            }
+
+            run_input(input.data(), input.size());
+            executions++;
+        }
+    }
+
+    for (const std::string& path : inputs)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error))
+        {
+            if (!run_file(path, executions))
+                return 1;
+            continue;
+        }
+
+        for (const auto& entry : std::filesystem::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file() && !run_file(entry.path().string(), executions))
+                return 1;
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    print_coverage();
+    std::fprintf(stderr, "%" PRIu64 " executions in %.2f s, %.0f per second\n", executions, elapsed.count(),
+        (elapsed.count() > 0) ? executions / elapsed.count() : 0.0);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,263 @@
+// chip8pack: builds and queries ROM packs
+//
+//   chip8pack build <pack> <manifest>
+//   chip8pack list <pack>
+//   chip8pack find <pack> <rom file | hash>
+//
+// Manifest lines are "<rom path> [platform=ch8|sc8|xo8] [quirks=N] [ips=N] [keys=XXXXXXXXXXXXXXXX]",
+// '#' starts a comment. Without a platform the ROM file extension is used.
+
+#include "chip8.hpp"
+#include "mapped_file.hpp"
+#include "rom_pack.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Largest ROM the platform loads, from the reset vector to the end of memory
+static size_t max_rom_size(PlatformType platform)
+{
+    return dispatch_platform(platform, 0, [](auto tag) {
+        using Platform = typename decltype(tag)::type;
+        return (size_t)(Platform::MemorySize - CHIP8Base::ResetVector);
+    });
+}
+
+static bool parse_key_layout(const std::string& value, uint8_t* key_layout)
+{
+    if (value.size() != 16)
+        return false;
+
+    for (int index = 0; index < 16; index++)
+    {
+        char digit[2] = { value[index], 0 };
+        char* end = nullptr;
+        unsigned long key = std::strtoul(digit, &end, 16);
+        if (*end != 0)
+            return false;
+
+        if ((index & 1) == 0)
+            key_layout[index / 2] = (uint8_t)(key << 4);
+        else
+            key_layout[index / 2] |= (uint8_t)key;
+    }
+
+    return true;
+}
+
+static bool parse_manifest_line(const std::string& line, std::string& path, RomMetadata& metadata, std::string& error)
+{
+    std::istringstream stream(line);
+    if (!(stream >> path))
+        return false;
+
+    metadata.platform = platform_from_file_name(path);
+    bool quirks_set = false;
+
+    std::string option;
+    while (stream >> option)
+    {
+        auto equal = option.find('=');
+        if (equal == std::string::npos)
+            return false;
+
+        std::string key = option.substr(0, equal);
+        std::string value = option.substr(equal + 1);
+
+        if (key == "platform")
+        {
+            if (!parse_platform(value, metadata.platform))
+                return false;
+        }
+        else if (key == "quirks")
+        {
+            char* end = nullptr;
+            metadata.quirks = (uint8_t)(std::strtoul(value.c_str(), &end, 0) & Quirk::Mask);
+            if (value.empty() || *end != 0)
+                return false;
+            quirks_set = true;
+        }
+        else if (key == "ips")
+        {
+            if (!parse_instructions_per_second(value, metadata.instructions_per_second))
+            {
+                error = "invalid ips=" + value + ", expected 1 to " + std::to_string(UINT16_MAX);
+                return false;
+            }
+        }
+        else if (key == "keys")
+        {
+            if (!parse_key_layout(value, metadata.key_layout))
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (!quirks_set)
+        metadata.quirks = default_quirks(metadata.platform);
+
+    return true;
+}
+
+static int build_pack(const std::string& pack_path, const std::string& manifest_path)
+{
+    std::ifstream manifest(manifest_path);
+    if (!manifest.is_open())
+    {
+        std::fprintf(stderr, "Cannot open manifest %s\n", manifest_path.c_str());
+        return 1;
+    }
+
+    RomPackBuilder builder;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(manifest, line))
+    {
+        line_number++;
+
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        std::string path;
+        RomMetadata metadata;
+        std::string error = "invalid manifest line";
+        if (!parse_manifest_line(line, path, metadata, error))
+        {
+            std::fprintf(stderr, "%s:%d: %s\n", manifest_path.c_str(), line_number, error.c_str());
+            return 1;
+        }
+
+        MappedFile rom;
+        if (!rom.open(path))
+        {
+            std::fprintf(stderr, "%s:%d: cannot open ROM file %s\n", manifest_path.c_str(), line_number, path.c_str());
+            return 1;
+        }
+
+        if (rom.size() > max_rom_size(metadata.platform))
+        {
+            std::fprintf(stderr, "%s:%d: ROM file %s is %zu bytes, %s ROMs hold at most %zu\n", manifest_path.c_str(), line_number, path.c_str(),
+                rom.size(), platform_name(metadata.platform), max_rom_size(metadata.platform));
+            return 1;
+        }
+
+        if (builder.contains(hash_rom(rom.data(), rom.size())))
+        {
+            std::fprintf(stderr, "%s:%d: skipping duplicate ROM %s\n", manifest_path.c_str(), line_number, path.c_str());
+            continue;
+        }
+
+        if (!builder.add(path, rom.data(), (uint32_t)rom.size(), metadata))
+        {
+            std::fprintf(stderr, "%s:%d: cannot add ROM %s\n", manifest_path.c_str(), line_number, path.c_str());
+            return 1;
+        }
+    }
+
+    if (!builder.write(pack_path))
+    {
+        std::fprintf(stderr, "Cannot write ROM pack %s\n", pack_path.c_str());
+        return 1;
+    }
+
+    std::printf("Wrote %u ROMs to %s\n", builder.count(), pack_path.c_str());
+
+    return 0;
+}
+
+static void print_entry(const RomPack& pack, const RomPackEntry& entry)
+{
+    RomMetadata metadata = pack.metadata(entry);
+
+    std::printf("%016" PRIx64 " %-10s quirks=0x%X ips=%u keys=", entry.hash, platform_name(metadata.platform), metadata.quirks, metadata.instructions_per_second);
+    for (int index = 0; index < 8; index++)
+        std::printf("%02X", metadata.key_layout[index]);
+    std::printf(" size=%u %s\n", entry.data_size, pack.rom_name(entry));
+}
+
+static int list_pack(const std::string& pack_path)
+{
+    RomPack pack;
+    if (!pack.open(pack_path))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", pack_path.c_str());
+        return 1;
+    }
+
+    for (uint32_t index = 0; index < pack.count(); index++)
+        print_entry(pack, pack.entry(index));
+
+    return 0;
+}
+
+static int find_rom(const std::string& pack_path, const std::string& query)
+{
+    RomPack pack;
+    if (!pack.open(pack_path))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", pack_path.c_str());
+        return 1;
+    }
+
+    uint64_t hash = 0;
+    MappedFile rom;
+    if (rom.open(query))
+    {
+        hash = hash_rom(rom.data(), rom.size());
+    }
+    else
+    {
+        char* end = nullptr;
+        hash = std::strtoull(query.c_str(), &end, 16);
+        if (query.empty() || *end != 0)
+        {
+            std::fprintf(stderr, "%s is neither a ROM file nor a hash\n", query.c_str());
+            return 1;
+        }
+    }
+
+    const RomPackEntry* entry = pack.find(hash);
+    if (!entry)
+    {
+        std::printf("%016" PRIx64 " not found\n", hash);
+        return 2;
+    }
+
+    print_entry(pack, *entry);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string command = (argc > 1) ? argv[1] : "";
+
+    if (command == "build" && argc == 4)
+        return build_pack(argv[2], argv[3]);
+
+    if (command == "list" && argc == 3)
+        return list_pack(argv[2]);
+
+    if (command == "find" && argc == 4)
+        return find_rom(argv[2], argv[3]);
+
+    std::fprintf(stderr,
+        "Usage:\n"
+        "  chip8pack build <pack> <manifest>\n"
+        "  chip8pack list <pack>\n"
+        "  chip8pack find <pack> <rom file | hash>\n");
+
+    return 1;
+}
@@ -0,0 +1,149 @@
+// chip8post: benchmarks the post-processing filters
+//
+//   chip8post [--width W] [--height H] [--frames N] [--threads N] [--rom <file>]
+//
+// Times every filter on a 128x64 display, or on the display of the given ROM after a
+// second of emulation, with the CRT stage rendering at W x H (3840x2160 by default).
+
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "palette.hpp"
+#include "post_process.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+
+static bool load_display(const std::string& rom_path, std::vector<uint32_t>& pixels, int& width, int& height)
+{
+    MappedFile rom;
+    if (!rom.open(rom_path) || rom.size() > UINT32_MAX)
+        return false;
+
+    const RomMetadata metadata = resolve_rom_metadata(rom_path, rom.data(), rom.size(), RomPack());
+    std::unique_ptr<Machine> machine = create_machine(metadata.platform, metadata.quirks);
+    if (!machine->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+        return false;
+
+    for (int frame = 0; frame < FramesPerSecond; frame++)
+    {
+        machine->run(instructions_per_frame(metadata));
+        machine->update_timers();
+    }
+
+    width = machine->display_width();
+    height = machine->display_height();
+    pixels.resize((size_t)width * height);
+    for (size_t index = 0; index < pixels.size(); index++)
+        pixels[index] = DisplayPalette[machine->get_display()[index] & 3];
+
+    return true;
+}
+
+// Blocky shapes with diagonal edges, closer to sprites than per pixel noise
+static void generate_display(std::vector<uint32_t>& pixels, int width, int height)
+{
+    std::mt19937 random(1);
+    pixels.assign((size_t)width * height, DisplayPalette[0]);
+
+    for (int shape = 0; shape < 48; shape++)
+    {
+        const int size = 2 + (int)(random() % 8);
+        const int left = (int)(random() % width);
+        const int top = (int)(random() % height);
+        const uint32_t color = DisplayPalette[1 + (random() % 3)];
+
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size - std::abs(y - size / 2); x++)
+                pixels[((size_t)((top + y) % height) * width) + ((left + x) % width)] = color;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int target_width = 3840;
+    int target_height = 2160;
+    int frames = 300;
+    int threads = 0;
+    std::string rom_path;
+
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        if (argument == "--width" && index + 1 < argc)
+            target_width = std::max(1, std::atoi(argv[++index]));
+        else if (argument == "--height" && index + 1 < argc)
+            target_height = std::max(1, std::atoi(argv[++index]));
+        else if (argument == "--frames" && index + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++index]));
+        else if (argument == "--threads" && index + 1 < argc)
+            threads = std::atoi(argv[++index]);
+        else if (argument == "--rom" && index + 1 < argc)
+            rom_path = argv[++index];
+        else
+        {
+            std::fprintf(stderr, "Usage: chip8post [--width W] [--height H] [--frames N] [--threads N] [--rom <file>]\n");
+            return 1;
+        }
+    }
+
+    int width = MaxDisplayWidth;
+    int height = MaxDisplayHeight;
+    std::vector<uint32_t> pixels;
+
+    if (rom_path.empty())
+        generate_display(pixels, width, height);
+    else if (!load_display(rom_path, pixels, width, height))
+    {
+        std::fprintf(stderr, "Cannot load ROM file %s\n", rom_path.c_str());
+        return 1;
+    }
+
+    PostProcessor processor(threads);
+    std::printf("%dx%d display, CRT at %dx%d, %d thread(s), %d frames\n", width, height, target_width, target_height, processor.threads(), frames);
+
+    static const ScaleFilter filters[] = { ScaleFilter::Scale2x, ScaleFilter::Scale4x, ScaleFilter::Smooth4x, ScaleFilter::None };
+    const double budget_ms = 1000.0 / FramesPerSecond;
+
+    for (int crt = 0; crt < 2; crt++)
+    {
+        for (ScaleFilter filter : filters)
+        {
+            if (filter == ScaleFilter::None && !crt)
+                continue;
+
+            processor.set_filter(filter);
+            processor.set_crt(crt != 0);
+            processor.process(pixels.data(), width, height, target_width, target_height);
+
+            double total_ms = 0.0;
+            double worst_ms = 0.0;
+            for (int frame = 0; frame < frames; frame++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                processor.process(pixels.data(), width, height, target_width, target_height);
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+                total_ms += elapsed.count();
+                worst_ms = std::max(worst_ms, elapsed.count());
+            }
+
+            std::string name = scale_filter_name(filter);
+            if (crt)
+                name = (filter == ScaleFilter::None) ? "CRT" : name + " + CRT";
+
+            std::printf("%-16s %5dx%-5d %8.3f ms/frame (worst %7.3f), %5.1f%% of a 60 fps frame\n", name.c_str(),
+                processor.output_width(), processor.output_height(), total_ms / frames, worst_ms, 100.0 * (total_ms / frames) / budget_ms);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,277 @@
+// chip8search: batch RAM search over several instances of a ROM
+//
+//   chip8search [--pack <file>] [--instances N] [--ips N] [--seed N] <rom> [script]
+//
+// Runs N instances (8 by default) seeded seed, seed + 1, ... and reads commands from
+// the script, or stdin, one per line:
+//
+//   run FRAMES               run every instance
+//   keys MASK                keypad state held by the following runs, e.g. keys 0x20
+//   snap                     capture a snapshot of every instance
+//   eq|ne|lt|gt|by N         filter on the current memory (by: changed by N, wrapping)
+//   same|changed|inc|dec     filter between the snapshots since the last filter
+//   reset                    every address becomes a candidate again
+//   list                     addresses left in every instance, with their values
+//
+// Addresses that behave the same way in every instance, despite the different random
+// seeds, are printed by list and are the ones worth a watchpoint in chip8dbg.
+
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "ram_search.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static inline constexpr auto DefaultInstances = 8;
+static inline constexpr auto ListLimit = 32;
+static inline constexpr auto ListValues = 8;
+
+struct SearchOptions
+{
+    std::string pack_path;
+    std::string rom_path;
+    std::string script_path;
+    int instances = DefaultInstances;
+    int instructions_per_second = 0;
+    uint32_t seed = 1;
+};
+
+static bool parse_number(const std::string& text, uint32_t& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    value = (uint32_t)std::strtoul(text.c_str(), &end, 0);
+
+    return *end == 0;
+}
+
+static bool parse_search_compare(const std::string& text, RamCompare& compare)
+{
+    static const struct
+    {
+        const char* name;
+        RamCompare compare;
+    } compares[] = {
+        { "eq", RamCompare::Equal }, { "ne", RamCompare::NotEqual }, { "lt", RamCompare::Less },
+        { "gt", RamCompare::Greater }, { "same", RamCompare::Unchanged }, { "changed", RamCompare::Changed },
+        { "inc", RamCompare::Increased }, { "dec", RamCompare::Decreased }, { "by", RamCompare::ChangedBy },
+    };
+
+    for (const auto& candidate : compares)
+    {
+        if (text == candidate.name)
+        {
+            compare = candidate.compare;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Candidates of every instance
+static std::vector<uint64_t> common_candidates(const RamSearchBatch& batch)
+{
+    std::vector<uint64_t> bits = batch.search(0).bits();
+    for (int index = 1; index < batch.count(); index++)
+    {
+        const std::vector<uint64_t>& other = batch.search(index).bits();
+        for (size_t word = 0; word < bits.size(); word++)
+            bits[word] &= other[word];
+    }
+
+    return bits;
+}
+
+static void print_counts(const RamSearchBatch& batch)
+{
+    uint32_t fewest = UINT32_MAX;
+    uint32_t most = 0;
+    for (int index = 0; index < batch.count(); index++)
+    {
+        fewest = std::min(fewest, batch.search(index).count());
+        most = std::max(most, batch.search(index).count());
+    }
+
+    uint32_t common = 0;
+    for (uint64_t word : common_candidates(batch))
+    {
+        for (; word != 0; word &= word - 1)
+            common++;
+    }
+
+    std::printf("%u candidates in every instance (%u to %u per instance)\n", common, fewest, most);
+}
+
+static void print_list(const RamSearchBatch& batch, const std::vector<std::unique_ptr<Machine>>& machines)
+{
+    const std::vector<uint64_t> bits = common_candidates(batch);
+    int listed = 0;
+
+    for (size_t word = 0; word < bits.size() && listed < ListLimit; word++)
+    {
+        for (int bit = 0; bit < 64 && listed < ListLimit; bit++)
+        {
+            if (((bits[word] >> bit) & 1) == 0)
+                continue;
+
+            const uint32_t address = (uint32_t)(word * 64) + bit;
+            std::printf("%04X =", address);
+            for (int index = 0; index < (int)machines.size() && index < ListValues; index++)
+                std::printf(" %02X", machines[index]->get_memory()[address]);
+            std::printf("\n");
+
+            listed++;
+        }
+    }
+}
+
+static bool parse_options(int argc, char* argv[], SearchOptions& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        bool has_value = (index + 1) < argc;
+
+        if (argument == "--pack" && has_value)
+            options.pack_path = argv[++index];
+        else if (argument == "--instances" && has_value)
+            options.instances = std::max(1, std::atoi(argv[++index]));
+        else if (argument == "--ips" && has_value)
+            options.instructions_per_second = std::atoi(argv[++index]);
+        else if (argument == "--seed" && has_value)
+            options.seed = (uint32_t)std::strtoul(argv[++index], nullptr, 0);
+        else if (options.rom_path.empty())
+            options.rom_path = argument;
+        else if (options.script_path.empty())
+            options.script_path = argument;
+        else
+            return false;
+    }
+
+    return !options.rom_path.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    SearchOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: chip8search [--pack <file>] [--instances N] [--ips N] [--seed N] <rom> [script]\n");
+        return 1;
+    }
+
+    MappedFile rom;
+    if (!rom.open(options.rom_path) || rom.size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "Cannot open ROM file %s\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    RomMetadata metadata;
+    if (!resolve_rom_metadata(options.rom_path, rom.data(), rom.size(), options.pack_path, metadata))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", options.pack_path.c_str());
+        return 1;
+    }
+
+    const int cycles_per_frame = instructions_per_frame(metadata, options.instructions_per_second);
+
+    std::vector<std::unique_ptr<Machine>> machines;
+    RamSearchBatch batch;
+
+    for (int index = 0; index < options.instances; index++)
+    {
+        std::unique_ptr<Machine> machine = create_machine(metadata.platform, metadata.quirks);
+        if (!machine->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+        {
+            std::fprintf(stderr, "ROM file %s does not fit in memory\n", options.rom_path.c_str());
+            return 1;
+        }
+
+        machine->seed(options.seed + (uint32_t)index);
+        machines.push_back(std::move(machine));
+        batch.add_instance(*machines.back());
+    }
+
+    std::ifstream script;
+    if (!options.script_path.empty())
+    {
+        script.open(options.script_path);
+        if (!script)
+        {
+            std::fprintf(stderr, "Cannot open script %s\n", options.script_path.c_str());
+            return 1;
+        }
+    }
+
+    std::istream& input = options.script_path.empty() ? std::cin : script;
+    uint16_t keys = 0;
+    std::string line;
+
+    while (std::getline(input, line))
+    {
+        std::istringstream arguments(line.substr(0, line.find('#')));
+        std::string command;
+        if (!(arguments >> command))
+            continue;
+
+        std::string value_text;
+        uint32_t value = 0;
+        RamCompare compare = RamCompare::Equal;
+
+        if (command == "run" && (arguments >> value_text) && parse_number(value_text, value))
+        {
+            for (uint32_t frame = 0; frame < value; frame++)
+            {
+                for (auto& machine : machines)
+                {
+                    machine->set_keys(keys);
+                    machine->run(cycles_per_frame);
+                    machine->update_timers();
+                }
+            }
+        }
+        else if (command == "keys" && (arguments >> value_text) && parse_number(value_text, value))
+        {
+            keys = (uint16_t)value;
+        }
+        else if (command == "snap")
+        {
+            if (!batch.capture())
+                std::printf("Snapshot limit reached (%zu), filter first\n", RamSearchBatch::MaxSnapshots);
+        }
+        else if (command == "reset")
+        {
+            batch.reset();
+            print_counts(batch);
+        }
+        else if (command == "list")
+        {
+            print_list(batch, machines);
+        }
+        else if (parse_search_compare(command, compare) && (!(arguments >> value_text) || parse_number(value_text, value)))
+        {
+            batch.filter(compare, (uint8_t)value);
+            print_counts(batch);
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown command: %s\n", line.c_str());
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+// chip8shm: headless core driven by another process through shared memory
+//
+//   chip8shm <name> [--pack <file>] [--ips N] [--seed N] <rom>
+//
+// Creates the POSIX shared memory segment <name> (e.g. /chip8), places the core
+// inside it and serves step requests until a client sends CHIP8_SHM_QUIT, or the
+// server gets SIGINT/SIGTERM/SIGHUP. Either way the segment is removed. See
+// chip8_shm.h for the layout and the handshake.
+
+#include "chip8.hpp"
+#include "chip8_shm.h"
+#include "mapped_file.hpp"
+#include "rom_pack.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <time.h>
+
+// The core starts on its own page, after the header
+static inline constexpr uint32_t CoreOffset = 4096;
+
+// Longest futex sleep before the quit flag is checked again
+static inline constexpr long QuitPollNanoseconds = 100 * 1000 * 1000;
+
+static volatile std::sig_atomic_t g_quit = 0;
+
+static void quit_handler(int)
+{
+    g_quit = 1;
+}
+
+static_assert(sizeof(chip8_shm_header) <= CoreOffset, "Shared memory header overlaps the core");
+static_assert(sizeof(struct chip8_shm_registers) == sizeof(CHIP8Base::Registers), "Register layout differs from chip8_shm.h");
+static_assert(offsetof(struct chip8_shm_registers, v) == offsetof(CHIP8Base::Registers, V), "Register layout differs from chip8_shm.h");
+
+struct ServerOptions
+{
+    std::string name;
+    std::string pack_path;
+    std::string rom_path;
+    int instructions_per_second = 0;
+    uint32_t seed = 1;
+};
+
+template <typename Core>
+static void publish_status(chip8_shm_header* header, Core& core, uint64_t frame)
+{
+    header->delay_timer = core.get_delay_timer();
+    header->sound_timer = core.get_sound_timer();
+    header->halted = core.halted() ? 1 : 0;
+    header->display_updated = core.display_updated() ? 1 : 0;
+    header->frame = frame;
+    header->state_hash = core.state_hash();
+    header->display_hash = core.display_hash();
+    core.display_rendered();
+}
+
+// chip8_shm_wait with a timed futex sleep, returns false once a signal asked the server to quit
+static bool wait_request(uint32_t* word, uint32_t value, uint32_t& request)
+{
+    const timespec timeout = { 0, QuitPollNanoseconds };
+
+    while (!g_quit)
+    {
+        for (int spin = 0; spin < CHIP8_SHM_SPIN_COUNT; spin++)
+        {
+            request = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+            if (request != value)
+                return true;
+        }
+
+        syscall(SYS_futex, word, FUTEX_WAIT, value, &timeout, nullptr, 0);
+    }
+
+    return false;
+}
+
+template <typename Platform>
+static int serve(const ServerOptions& options, const MappedFile& rom, const RomMetadata& metadata)
+{
+    using Core = CHIP8<Platform, Feature::StateHash>;
+    const uint32_t segment_size = (uint32_t)((CoreOffset + sizeof(Core) + 4095) & ~size_t(4095));
+
+    int fd = shm_open(options.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "Cannot create shared memory segment %s\n", options.name.c_str());
+        return 1;
+    }
+
+    void* segment = MAP_FAILED;
+    if (ftruncate(fd, segment_size) == 0)
+        segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (segment == MAP_FAILED)
+    {
+        std::fprintf(stderr, "Cannot map shared memory segment %s\n", options.name.c_str());
+        shm_unlink(options.name.c_str());
+        return 1;
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(segment);
+    chip8_shm_header* header = new (base) chip8_shm_header();
+    Core* core = new (base + CoreOffset) Core();
+
+    if (!core->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+    {
+        std::fprintf(stderr, "Cannot load ROM file %s into memory, size is %zu\n", options.rom_path.c_str(), rom.size());
+        munmap(segment, segment_size);
+        shm_unlink(options.name.c_str());
+        return 1;
+    }
+
+    core->seed(options.seed);
+
+    const int cycles_per_frame = instructions_per_frame(metadata, options.instructions_per_second);
+
+    header->segment_size = segment_size;
+    header->platform = (uint32_t)metadata.platform;
+    header->quirks = metadata.quirks;
+    header->display_width = Core::DisplayWidth;
+    header->display_height = Core::DisplayHeight;
+    header->display_planes = Platform::Planes;
+    header->memory_size = Core::MemorySize;
+    header->cycles_per_frame = (uint32_t)cycles_per_frame;
+    header->display_offset = (uint32_t)(core->get_display() - base);
+    header->registers_offset = (uint32_t)(reinterpret_cast<const uint8_t*>(&core->get_registers()) - base);
+    header->memory_offset = (uint32_t)(core->get_memory() - base);
+
+    uint64_t frame = 0;
+    publish_status(header, *core, frame);
+
+    // Clients check the magic last, everything above is visible once it is set
+    header->version = CHIP8_SHM_VERSION;
+    __atomic_store_n(&header->magic, CHIP8_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    std::printf("Serving %s on %s (%s, %u bytes)\n", options.rom_path.c_str(), options.name.c_str(), platform_name(metadata.platform), segment_size);
+    std::fflush(stdout);
+
+    uint32_t handled = 0;
+    uint32_t request = 0;
+    bool running = true;
+
+    while (running)
+    {
+        if (!wait_request(&header->request, handled, request))
+            break;
+
+        handled = request;
+
+        const uint32_t argument = header->argument;
+        core->set_keys((uint16_t)__atomic_load_n(&header->keys, __ATOMIC_RELAXED));
+
+        switch (header->command)
+        {
+        case CHIP8_SHM_STEP_FRAMES:
+            for (uint32_t index = 0; index < argument; index++)
+            {
+                core->run(cycles_per_frame);
+                core->update_timers();
+            }
+            frame += argument;
+            break;
+
+        case CHIP8_SHM_STEP_CYCLES:
+            core->run((int)argument);
+            break;
+
+        case CHIP8_SHM_RESET:
+            core->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size());
+            core->seed(argument);
+            frame = 0;
+            break;
+
+        case CHIP8_SHM_QUIT:
+            running = false;
+            break;
+        }
+
+        publish_status(header, *core, frame);
+        chip8_shm_signal(&header->response, request);
+    }
+
+    munmap(segment, segment_size);
+    shm_unlink(options.name.c_str());
+
+    return 0;
+}
+
+static bool parse_options(int argc, char* argv[], ServerOptions& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        bool has_value = (index + 1) < argc;
+
+        if (argument == "--pack" && has_value)
+            options.pack_path = argv[++index];
+        else if (argument == "--ips" && has_value)
+            options.instructions_per_second = std::atoi(argv[++index]);
+        else if (argument == "--seed" && has_value)
+            options.seed = (uint32_t)std::strtoul(argv[++index], nullptr, 0);
+        else if (options.name.empty())
+            options.name = argument;
+        else if (options.rom_path.empty())
+            options.rom_path = argument;
+        else
+            return false;
+    }
+
+    return options.name.size() > 1 && options.name[0] == '/' && !options.rom_path.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    ServerOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: chip8shm </name> [--pack <file>] [--ips N] [--seed N] <rom>\n");
+        return 1;
+    }
+
+    MappedFile rom;
+    if (!rom.open(options.rom_path))
+    {
+        std::fprintf(stderr, "Cannot open ROM file %s\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    RomMetadata metadata;
+    if (!resolve_rom_metadata(options.rom_path, rom.data(), rom.size(), options.pack_path, metadata))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", options.pack_path.c_str());
+        return 1;
+    }
+
+    if (rom.size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "ROM file %s is too large\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    std::signal(SIGINT, quit_handler);
+    std::signal(SIGTERM, quit_handler);
+    std::signal(SIGHUP, quit_handler);
+
+    return dispatch_platform(metadata.platform, metadata.quirks, [&](auto platform) {
+        using Platform = typename decltype(platform)::type;
+        return serve<Platform>(options, rom, metadata);
+    });
+}
@@ -0,0 +1,102 @@
+/*
+ * chip8shm_client: reference client for chip8shm
+ *
+ *   chip8shm_client <name> [frames] [--quit]
+ *
+ * Steps the core one frame at a time while pressing a different key every 30 frames,
+ * reports the average round trip and prints the final display and registers.
+ */
+
+#include "chip8_shm.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_microseconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e6 + (double)time.tv_nsec / 1e3;
+}
+
+static void print_display(const struct chip8_shm_header* header)
+{
+    const uint8_t* display = chip8_shm_display(header);
+    uint32_t x;
+    uint32_t y;
+
+    /* Two display rows per text line */
+    for (y = 0; y < header->display_height; y += 2)
+    {
+        for (x = 0; x < header->display_width; x++)
+        {
+            int top = display[y * header->display_width + x] != 0;
+            int bottom = display[(y + 1) * header->display_width + x] != 0;
+            putchar(top ? (bottom ? '#' : '"') : (bottom ? '.' : ' '));
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    struct chip8_shm_header* header;
+    const struct chip8_shm_registers* registers;
+    int frames = 600;
+    int quit = 0;
+    int frame;
+    int index;
+    double start;
+    double elapsed;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: chip8shm_client </name> [frames] [--quit]\n");
+        return 1;
+    }
+
+    for (index = 2; index < argc; index++)
+    {
+        if (strcmp(argv[index], "--quit") == 0)
+            quit = 1;
+        else
+            frames = atoi(argv[index]);
+    }
+
+    header = chip8_shm_attach(argv[1]);
+    if (!header)
+    {
+        fprintf(stderr, "Cannot attach to shared memory segment %s\n", argv[1]);
+        return 1;
+    }
+
+    start = now_microseconds();
+    for (frame = 0; frame < frames; frame++)
+    {
+        chip8_shm_set_keys(header, (uint16_t)(((frame / 30) & 1) ? 1u << ((frame / 60) & 15) : 0));
+        chip8_shm_call(header, CHIP8_SHM_STEP_FRAMES, 1);
+    }
+    elapsed = now_microseconds() - start;
+
+    chip8_shm_set_keys(header, 0);
+    print_display(header);
+
+    registers = chip8_shm_registers(header);
+    printf("PC=%03X I=%03X SP=%X DT=%02X ST=%02X V=", registers->pc, registers->i, registers->sp, header->delay_timer, header->sound_timer);
+    for (index = 0; index < 16; index++)
+        printf("%02X", registers->v[index]);
+    printf("\nframe=%" PRIu64 " state=%016" PRIx64 " display=%016" PRIx64 "\n", header->frame, header->state_hash, header->display_hash);
+
+    if (frames > 0)
+        printf("%d steps, %.2f us per round trip\n", frames, elapsed / frames);
+
+    if (quit)
+        chip8_shm_call(header, CHIP8_SHM_QUIT, 0);
+
+    chip8_shm_detach(header);
+
+    return 0;
+}
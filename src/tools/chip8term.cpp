@@ -0,0 +1,494 @@
+// chip8term: plays a ROM in a terminal, for headless machines and SSH sessions
+//
+//   chip8term [--pack <file>] [--ips N] [--seed N] [--braille] [--hold N] [--bell] [--frames N] <rom>
+//
+// The display is drawn with half blocks, or braille cells with --braille, and each frame only
+// sends the cells that changed in a single write. Keys are the 1234/QWER/ASDF/ZXCV grid, Esc
+// or Ctrl+C quits. Terminals supporting the kitty keyboard protocol report key releases,
+// elsewhere a key is held for --hold frames (8 by default) after each press or autorepeat.
+// When the terminal is too small for half blocks the display falls back to braille, and play
+// pauses with a notice while even braille does not fit.
+
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "rom_pack.hpp"
+#include "terminal_view.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static inline constexpr auto DefaultHoldFrames = 8;
+
+// Host keys for the 4x4 keypad grid, RomMetadata::key_layout maps each position to a CHIP-8 key
+static const char KeypadKeys[] = "1234qwerasdfzxcv";
+
+static volatile std::sig_atomic_t g_quit = 0;
+static volatile std::sig_atomic_t g_resized = 0;
+
+static void quit_handler(int)
+{
+    g_quit = 1;
+}
+
+static void resize_handler(int)
+{
+    g_resized = 1;
+}
+
+struct TerminalOptions
+{
+    std::string pack_path;
+    std::string rom_path;
+    int instructions_per_second = 0;
+    uint32_t seed = 1;
+    bool braille = false;
+    int hold_frames = DefaultHoldFrames;
+    bool bell = false;
+    int frames = 0;
+};
+
+static bool write_all(const std::string& text)
+{
+    size_t offset = 0;
+    while (offset < text.size())
+    {
+        const ssize_t written = ::write(STDOUT_FILENO, text.data() + offset, text.size() - offset);
+        if (written < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+
+            return false;
+        }
+
+        offset += (size_t)written;
+    }
+
+    return true;
+}
+
+// Raw mode without echo, reads return at once with whatever is buffered. Signals are kept so
+// Ctrl+C still quits on terminals that do not encode it as a key event.
+class RawTerminal
+{
+public:
+    ~RawTerminal() { restore(); }
+
+    bool enter()
+    {
+        if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &m_saved) != 0)
+            return false;
+
+        termios raw = m_saved;
+        raw.c_iflag &= ~(IXON | ICRNL);
+        raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+            return false;
+
+        m_active = true;
+
+        // Alternate screen, hidden cursor, kitty keyboard flags (disambiguate, event types, all
+        // keys as escapes) and a query of those flags to find out whether they took effect
+        return write_all("\x1b[?1049h\x1b[?25l\x1b[2J\x1b[>11u\x1b[?u");
+    }
+
+    void restore()
+    {
+        if (!m_active)
+            return;
+
+        write_all("\x1b[<u\x1b[0m\x1b[?25h\x1b[?1049l");
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &m_saved);
+        m_active = false;
+    }
+
+private:
+    termios m_saved = {};
+    bool m_active = false;
+};
+
+class TerminalKeypad
+{
+public:
+    TerminalKeypad(const RomMetadata& metadata, int hold_frames)
+        : m_hold_frames(hold_frames)
+    {
+        for (int index = 0; index < CHIP8Base::KeyCount; index++)
+            m_layout[index] = (metadata.key_layout[index / 2] >> ((index & 1) ? 0 : 4)) & 0xF;
+    }
+
+    bool quit_requested() const { return m_quit; }
+    bool reports_releases() const { return m_releases; }
+
+    // Drains the terminal input and returns the keys held for this frame
+    uint16_t poll_keys()
+    {
+        char buffer[256];
+        ssize_t size = 0;
+        while ((size = ::read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+            m_pending.append(buffer, (size_t)size);
+
+        parse();
+
+        uint16_t keys = 0;
+        for (int index = 0; index < CHIP8Base::KeyCount; index++)
+        {
+            if (m_hold[index] != 0)
+                keys |= 1 << m_layout[index];
+
+            if (m_hold[index] > 0)
+                m_hold[index]--;
+        }
+
+        return keys;
+    }
+
+private:
+    uint8_t m_layout[CHIP8Base::KeyCount] = { 0 };
+    // Frames left for each grid position, -1 while held until a release event
+    int m_hold[CHIP8Base::KeyCount] = { 0 };
+    int m_hold_frames;
+    bool m_releases = false;
+    bool m_quit = false;
+    bool m_lone_escape = false;
+    std::string m_pending;
+
+    void key_event(uint32_t key, bool ctrl, int event)
+    {
+        if (key == 27 || (ctrl && key == 'c'))
+        {
+            m_quit = true;
+            return;
+        }
+
+        if (key >= 'A' && key <= 'Z')
+            key += 'a' - 'A';
+
+        const char* position = (key < 128 && key != 0) ? std::strchr(KeypadKeys, (int)key) : nullptr;
+        if (!position)
+            return;
+
+        const int index = (int)(position - KeypadKeys);
+        if (event == 3)
+            m_hold[index] = 0;
+        else
+            m_hold[index] = m_releases ? -1 : std::max(m_hold[index], m_hold_frames);
+    }
+
+    // CSI sequences: "CSI key[:alternates] [; modifiers[:event]] u" for kitty key events,
+    // "CSI ? flags u" answers the flags query, anything else is ignored
+    void parse_sequence(const std::string& parameters, char final)
+    {
+        if (final != 'u')
+            return;
+
+        if (!parameters.empty() && parameters[0] == '?')
+        {
+            m_releases = true;
+            return;
+        }
+
+        const char* text = parameters.c_str();
+        char* end = nullptr;
+        const uint32_t key = (uint32_t)std::strtoul(text, &end, 10);
+        while (*end != 0 && *end != ';')
+            end++;
+
+        uint32_t modifiers = 1;
+        int event = 1;
+        if (*end == ';')
+        {
+            modifiers = (uint32_t)std::strtoul(end + 1, &end, 10);
+            if (*end == ':')
+                event = (int)std::strtol(end + 1, &end, 10);
+        }
+
+        key_event(key, modifiers > 0 && ((modifiers - 1) & 4), event);
+    }
+
+    void parse()
+    {
+        size_t offset = 0;
+        while (offset < m_pending.size())
+        {
+            const char byte = m_pending[offset];
+            if (byte != '\x1b')
+            {
+                key_event((uint8_t)byte, false, 1);
+                offset++;
+                continue;
+            }
+
+            // An escape still alone a frame later is the Esc key, a truncated sequence waits
+            if (offset + 1 == m_pending.size())
+            {
+                if (m_lone_escape)
+                {
+                    key_event(27, false, 1);
+                    offset++;
+                }
+
+                m_lone_escape = !m_lone_escape;
+                break;
+            }
+
+            m_lone_escape = false;
+
+            if (m_pending[offset + 1] != '[')
+            {
+                offset += 2;
+                continue;
+            }
+
+            size_t final = offset + 2;
+            while (final < m_pending.size() && (m_pending[final] < 0x40 || m_pending[final] > 0x7E))
+                final++;
+
+            if (final == m_pending.size())
+                break;
+
+            parse_sequence(m_pending.substr(offset + 2, final - offset - 2), m_pending[final]);
+            offset = final + 1;
+        }
+
+        m_pending.erase(0, offset);
+    }
+};
+
+// Picks the preferred cells when the display and the status line fit in the terminal, else
+// braille. Returns false with a notice to show instead of the display when neither fits.
+static bool fit_view(TerminalView& view, TerminalCells preferred, int width, int height, std::string& notice)
+{
+    winsize size = {};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0)
+    {
+        view.set_cells(preferred);
+        return true;
+    }
+
+    int columns = 0;
+    int rows = 0;
+    for (TerminalCells cells : { preferred, TerminalCells::Braille })
+    {
+        TerminalView::grid_size(cells, width, height, columns, rows);
+        if (columns <= size.ws_col && rows + 1 <= size.ws_row)
+        {
+            view.set_cells(cells);
+            return true;
+        }
+    }
+
+    int braille_columns = 0;
+    int braille_rows = 0;
+    TerminalView::grid_size(preferred, width, height, columns, rows);
+    TerminalView::grid_size(TerminalCells::Braille, width, height, braille_columns, braille_rows);
+
+    char text[160];
+    std::snprintf(text, sizeof(text), "Terminal is %dx%d, the %dx%d display needs %dx%d (%dx%d with braille). Paused, Esc quits.",
+        size.ws_col, size.ws_row, width, height, columns, rows + 1, braille_columns, braille_rows + 1);
+    notice = text;
+    return false;
+}
+
+static bool parse_options(int argc, char* argv[], TerminalOptions& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string argument = argv[index];
+        bool has_value = (index + 1) < argc;
+
+        if (argument == "--pack" && has_value)
+            options.pack_path = argv[++index];
+        else if (argument == "--ips" && has_value)
+            options.instructions_per_second = std::atoi(argv[++index]);
+        else if (argument == "--seed" && has_value)
+            options.seed = (uint32_t)std::strtoul(argv[++index], nullptr, 0);
+        else if (argument == "--braille")
+            options.braille = true;
+        else if (argument == "--hold" && has_value)
+            options.hold_frames = std::max(1, std::atoi(argv[++index]));
+        else if (argument == "--bell")
+            options.bell = true;
+        else if (argument == "--frames" && has_value)
+            options.frames = std::max(0, std::atoi(argv[++index]));
+        else if (options.rom_path.empty())
+            options.rom_path = argument;
+        else
+            return false;
+    }
+
+    return !options.rom_path.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    TerminalOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: chip8term [--pack <file>] [--ips N] [--seed N] [--braille] [--hold N] [--bell] [--frames N] <rom>\n");
+        return 1;
+    }
+
+    MappedFile rom;
+    if (!rom.open(options.rom_path) || rom.size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "Cannot open ROM file %s\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    RomMetadata metadata;
+    if (!resolve_rom_metadata(options.rom_path, rom.data(), rom.size(), options.pack_path, metadata))
+    {
+        std::fprintf(stderr, "Cannot open ROM pack %s\n", options.pack_path.c_str());
+        return 1;
+    }
+
+    const int cycles_per_frame = instructions_per_frame(metadata, options.instructions_per_second);
+
+    std::unique_ptr<Machine> machine = create_machine(metadata.platform, metadata.quirks);
+    if (!machine->load_rom_in_memory(reinterpret_cast<const char*>(rom.data()), (uint32_t)rom.size()))
+    {
+        std::fprintf(stderr, "ROM file %s does not fit in memory\n", options.rom_path.c_str());
+        return 1;
+    }
+
+    machine->seed(options.seed);
+
+    RawTerminal terminal;
+    if (!terminal.enter())
+    {
+        std::fprintf(stderr, "chip8term needs a terminal on stdin and stdout\n");
+        return 1;
+    }
+
+    std::signal(SIGINT, quit_handler);
+    std::signal(SIGTERM, quit_handler);
+    std::signal(SIGHUP, quit_handler);
+    std::signal(SIGWINCH, resize_handler);
+
+    TerminalView view;
+    TerminalKeypad keypad(metadata, options.hold_frames);
+
+    const std::string rom_name = options.rom_path.substr(options.rom_path.find_last_of("/\\") + 1);
+    const auto frame_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / FramesPerSecond));
+    auto next_frame = std::chrono::steady_clock::now();
+    auto status_time = next_frame;
+
+    const TerminalCells preferred_cells = options.braille ? TerminalCells::Braille : TerminalCells::HalfBlocks;
+    std::string output;
+    std::string notice;
+    int width = 0;
+    int height = 0;
+    bool fits = true;
+    bool sound_active = false;
+    uint64_t frames = 0;
+    uint64_t total_bytes = 0;
+    uint64_t status_frames = 0;
+    uint64_t status_bytes = 0;
+    char status[160] = "";
+
+    while (!g_quit && !keypad.quit_requested() && (options.frames == 0 || frames < (uint64_t)options.frames))
+    {
+        const uint16_t keys = keypad.poll_keys();
+        if (fits)
+        {
+            machine->set_keys(keys);
+            machine->run(cycles_per_frame);
+            machine->update_timers();
+        }
+
+        output.clear();
+
+        bool redraw = false;
+        if (machine->display_width() != width || machine->display_height() != height)
+        {
+            width = machine->display_width();
+            height = machine->display_height();
+            view.resize(width, height);
+            redraw = true;
+        }
+
+        if (g_resized)
+        {
+            g_resized = 0;
+            view.invalidate();
+            redraw = true;
+        }
+
+        // Checked again whenever the terminal or the display resolution changes
+        if (redraw)
+        {
+            fits = fit_view(view, preferred_cells, width, height, notice);
+            output += "\x1b[0m\x1b[2J";
+        }
+
+        if (!fits)
+        {
+            if (redraw)
+                output += "\x1b[1;1H" + notice;
+        }
+        else if (redraw || machine->display_updated())
+        {
+            view.render(machine->get_display(), output);
+            machine->display_rendered();
+        }
+
+        if (options.bell && machine->sound_active() && !sound_active)
+            output += '\a';
+        sound_active = machine->sound_active();
+
+        frames++;
+        status_frames++;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (fits && (redraw || now - status_time >= std::chrono::seconds(1)))
+        {
+            const double seconds = std::max(std::chrono::duration<double>(now - status_time).count(), 1e-3);
+            if (!redraw)
+            {
+                std::snprintf(status, sizeof(status), "%s | %s | %.0f fps | %.0f bytes/frame | %s | Esc quits", rom_name.c_str(),
+                    platform_name(metadata.platform), status_frames / seconds, (double)status_bytes / status_frames,
+                    keypad.reports_releases() ? "key releases" : "timed keys");
+                status_time = now;
+                status_frames = 0;
+                status_bytes = 0;
+            }
+
+            char move[32];
+            std::snprintf(move, sizeof(move), "\x1b[%d;1H\x1b[K", view.rows() + 1);
+            output += move;
+            output += status;
+        }
+
+        if (!output.empty() && !write_all(output))
+            break;
+
+        total_bytes += output.size();
+        status_bytes += output.size();
+
+        next_frame += frame_duration;
+        if (next_frame < now)
+            next_frame = now;
+        std::this_thread::sleep_until(next_frame);
+    }
+
+    terminal.restore();
+
+    std::printf("%llu frames, %llu bytes, %.1f bytes/frame\n", (unsigned long long)frames, (unsigned long long)total_bytes,
+        frames ? (double)total_bytes / frames : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include "wall_view.hpp"
+#include "palette.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <SDL.h>
+
+WallView::WallView()
+{
+}
+
+WallView::~WallView()
+{
+    SDL_DestroyTexture(m_atlas);
+}
+
+void WallView::add_instance(std::unique_ptr<Machine> machine, const RomMetadata& metadata, const std::string& name, int cycles_per_frame)
+{
+    Instance instance;
+    instance.machine = std::move(machine);
+    instance.metadata = metadata;
+    instance.name = name;
+    instance.cycles_per_frame = cycles_per_frame;
+    // Empty displays hash to zero, force the first frame to be drawn
+    instance.presented_hash = ~0ull;
+
+    m_instances.push_back(std::move(instance));
+}
+
+bool WallView::init(SDL_Renderer* renderer)
+{
+    if (m_instances.empty())
+        return false;
+
+    // Every tile is as large as the largest display, smaller displays are scaled up
+    for (const auto& instance : m_instances)
+    {
+        m_tile_width = std::max(m_tile_width, instance.machine->display_width());
+        m_tile_height = std::max(m_tile_height, instance.machine->display_height());
+    }
+
+    m_columns = (int)std::ceil(std::sqrt((double)m_instances.size()));
+    m_rows = ((int)m_instances.size() + m_columns - 1) / m_columns;
+    m_atlas_width = m_columns * (m_tile_width + TileSpacing);
+    m_atlas_height = m_rows * (m_tile_height + TileSpacing);
+
+    m_atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, m_atlas_width, m_atlas_height);
+    if (!m_atlas)
+        return false;
+
+    m_atlas_pixels.assign((size_t)m_atlas_width * m_atlas_height, SpacingColor);
+    m_dirty_first.assign(m_rows, m_columns);
+    m_dirty_last.assign(m_rows, -1);
+
+    for (int index = 0; index < count(); index++)
+        draw_tile(index);
+
+    // Streaming textures start undefined, upload the spacing lines once
+    SDL_UpdateTexture(m_atlas, nullptr, m_atlas_pixels.data(), m_atlas_width * sizeof(uint32_t));
+    m_dirty_first.assign(m_rows, m_columns);
+    m_dirty_last.assign(m_rows, -1);
+
+    return true;
+}
+
+void WallView::run_frame(uint16_t focused_keys)
+{
+    for (int index = 0; index < count(); index++)
+    {
+        Instance& instance = m_instances[index];
+        Machine& machine = *instance.machine;
+
+        const uint16_t keys = (index == m_focus) ? focused_keys : 0;
+        machine.set_keys(keys);
+        machine.run(instance.cycles_per_frame);
+        machine.update_timers();
+
+        if (instance.capture)
+            instance.capture->add_frame(machine.get_display(), machine.get_sound_timer(), keys);
+
+        if (!machine.display_updated())
+            continue;
+
+        // ROMs often erase and redraw the same sprites, the display hash filters those out
+        machine.display_rendered();
+        uint64_t hash = machine.display_hash();
+        if (hash == instance.presented_hash)
+            continue;
+
+        instance.presented_hash = hash;
+        draw_tile(index);
+    }
+}
+
+void WallView::render(SDL_Renderer* renderer)
+{
+    const int stride_width = m_tile_width + TileSpacing;
+    const int stride_height = m_tile_height + TileSpacing;
+
+    for (int row = 0; row < m_rows; row++)
+    {
+        if (m_dirty_last[row] < m_dirty_first[row])
+            continue;
+
+        SDL_Rect band;
+        band.x = m_dirty_first[row] * stride_width;
+        band.y = row * stride_height;
+        band.w = (m_dirty_last[row] - m_dirty_first[row] + 1) * stride_width;
+        band.h = stride_height;
+
+        const uint32_t* pixels = m_atlas_pixels.data() + ((size_t)band.y * m_atlas_width) + band.x;
+        SDL_UpdateTexture(m_atlas, &band, pixels, m_atlas_width * sizeof(uint32_t));
+
+        m_dirty_first[row] = m_columns;
+        m_dirty_last[row] = -1;
+    }
+
+    SDL_RenderClear(renderer);
+
+    if (m_focus >= 0)
+    {
+        SDL_Rect tile;
+        tile.x = (m_focus % m_columns) * stride_width;
+        tile.y = (m_focus / m_columns) * stride_height;
+        tile.w = m_tile_width;
+        tile.h = m_tile_height;
+        SDL_RenderCopy(renderer, m_atlas, &tile, nullptr);
+    }
+    else
+    {
+        SDL_RenderCopy(renderer, m_atlas, nullptr, nullptr);
+    }
+
+    SDL_RenderPresent(renderer);
+}
+
+void WallView::reset()
+{
+    for (int index = 0; index < count(); index++)
+    {
+        if (m_focus < 0 || index == m_focus)
+            m_instances[index].machine->reset();
+    }
+}
+
+bool WallView::start_capture(CaptureWriter& writer, const std::string& path)
+{
+    for (int index = 0; index < count(); index++)
+    {
+        Instance& instance = m_instances[index];
+        const Machine& machine = *instance.machine;
+
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "_%04d", index);
+
+        instance.capture = std::make_unique<CaptureEncoder>();
+        if (!instance.capture->open(writer, capture_file_name(path, suffix), machine.display_width(), machine.display_height(), machine.display_planes()))
+        {
+            instance.capture.reset();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int WallView::instance_at(int x, int y, int window_width, int window_height) const
+{
+    if (window_width <= 0 || window_height <= 0 || x < 0 || y < 0)
+        return -1;
+
+    const int column = (int)((int64_t)x * m_atlas_width / window_width) / (m_tile_width + TileSpacing);
+    const int row = (int)((int64_t)y * m_atlas_height / window_height) / (m_tile_height + TileSpacing);
+    const int index = row * m_columns + column;
+
+    if (column >= m_columns || row >= m_rows || index >= count())
+        return -1;
+
+    return index;
+}
+
+void WallView::set_focus(int index)
+{
+    m_focus = (index >= 0 && index < count()) ? index : -1;
+}
+
+void WallView::draw_tile(int index)
+{
+    const Machine& machine = *m_instances[index].machine;
+    const uint8_t* display = machine.get_display();
+    const int width = machine.display_width();
+    const int height = machine.display_height();
+    const int scale_x = m_tile_width / width;
+    const int scale_y = m_tile_height / height;
+
+    const int column = index % m_columns;
+    const int row = index / m_columns;
+    uint32_t* tile = m_atlas_pixels.data() + ((size_t)row * (m_tile_height + TileSpacing) * m_atlas_width) + (column * (m_tile_width + TileSpacing));
+
+    for (int y = 0; y < m_tile_height; y++)
+    {
+        const uint8_t* source = display + ((y / scale_y) * width);
+        uint32_t* target = tile + ((size_t)y * m_atlas_width);
+
+        for (int x = 0; x < m_tile_width; x++)
+            target[x] = DisplayPalette[source[x / scale_x] & 3];
+    }
+
+    m_dirty_first[row] = std::min(m_dirty_first[row], column);
+    m_dirty_last[row] = std::max(m_dirty_last[row], column);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "capture.hpp"
+#include "machine.hpp"
+#include "rom_pack.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct SDL_Renderer;
+struct SDL_Texture;
+
+// Runs many cores side by side and shows all of their displays from a single
+// streaming texture atlas: only tiles whose display changed are converted and
+// uploaded, and a frame is a single SDL_RenderCopy of either the whole atlas or
+// the focused tile.
+class WallView
+{
+public:
+    WallView();
+    ~WallView();
+
+    void add_instance(std::unique_ptr<Machine> machine, const RomMetadata& metadata, const std::string& name, int cycles_per_frame);
+    bool init(SDL_Renderer* renderer);
+    void run_frame(uint16_t focused_keys);
+    void render(SDL_Renderer* renderer);
+    void reset();
+    // Captures every instance to its own file, the path gets the instance index before the extension
+    bool start_capture(CaptureWriter& writer, const std::string& path);
+
+    int count() const { return (int)m_instances.size(); }
+    int instance_at(int x, int y, int window_width, int window_height) const;
+    void set_focus(int index);
+    int focus() const { return m_focus; }
+    Machine& machine(int index) { return *m_instances[index].machine; }
+    const RomMetadata& metadata(int index) const { return m_instances[index].metadata; }
+    const std::string& name(int index) const { return m_instances[index].name; }
+
+private:
+    struct Instance
+    {
+        std::unique_ptr<Machine> machine;
+        RomMetadata metadata;
+        std::string name;
+        int cycles_per_frame = 0;
+        uint64_t presented_hash = 0;
+        std::unique_ptr<CaptureEncoder> capture;
+    };
+
+    std::vector<Instance> m_instances;
+    int m_focus = -1;
+
+    SDL_Texture* m_atlas = nullptr;
+    std::vector<uint32_t> m_atlas_pixels;
+    int m_atlas_width = 0;
+    int m_atlas_height = 0;
+    int m_tile_width = 0;
+    int m_tile_height = 0;
+    int m_columns = 0;
+    int m_rows = 0;
+
+    // Dirty column span per atlas row, uploaded as one band per row
+    std::vector<int> m_dirty_first;
+    std::vector<int> m_dirty_last;
+
+    static inline constexpr auto TileSpacing = 1;
+    static inline constexpr uint32_t SpacingColor = 0xFF202020;
+
+    void draw_tile(int index);
+};